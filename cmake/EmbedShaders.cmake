@@ -0,0 +1,58 @@
+#Writes the shader files into one C++ source as byte arrays behind ShaderSources::find,
+#run at build time by the custom command in the top level CMakeLists.txt
+#
+#usage: cmake -DOUTPUT=<file.cpp> -DSHADERS=<file;file;...> -P EmbedShaders.cmake
+
+#32 bytes of hex per line keeps the generated lines short
+set(row "")
+foreach(i RANGE 31)
+    set(row "${row}[0-9a-f][0-9a-f]")
+endforeach()
+
+set(arrays "")
+set(table "")
+set(index 0)
+foreach(shader ${SHADERS})
+    get_filename_component(name ${shader} NAME)
+    file(READ ${shader} hex HEX)
+    string(REGEX REPLACE "(${row})" "\\1\n" hex "${hex}")
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${hex}")
+    set(arrays "${arrays}static const unsigned char source${index}[] =\n{\n${bytes}0x00\n};\n\n")
+    set(table "${table}\t\t{ \"${name}\", (const char*)source${index} },\n")
+    math(EXPR index "${index} + 1")
+endforeach()
+
+file(WRITE ${OUTPUT}
+"//generated by cmake/EmbedShaders.cmake, do not edit
+#include \"RenderUtilities/ShaderSources.h\"
+
+#include <cctype>
+
+namespace
+{
+${arrays}	//the sources name their files as they are spelled on Windows, whatever the case on disk
+	bool sameName(const std::string& name, const char* file)
+	{
+		size_t i = 0;
+		for (; i < name.size() && file[i]; i++)
+		{
+			if (tolower((unsigned char)name[i]) != tolower((unsigned char)file[i]))
+				return false;
+		}
+		return i == name.size() && !file[i];
+	}
+}
+
+const char* ShaderSources::find(const std::string& name)
+{
+	static const struct { const char* name; const char* source; } files[] =
+	{
+${table}\t};
+	for (const auto& file : files)
+	{
+		if (sameName(name, file.name))
+			return file.source;
+	}
+	return nullptr;
+}
+")
@@ -0,0 +1,297 @@
+#include "BlockCompressor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSOR_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	//4x4 texels of one block, rows and columns past the edge repeat the last one
+	void fetchBlock(const unsigned char* pixels, int width, int height, size_t stride, int channels, int bx, int by, int keep, unsigned char* texels)
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			const unsigned char* row = pixels + std::min(by * 4 + y, height - 1) * stride;
+			for (int x = 0; x < 4; x++)
+			{
+				const unsigned char* texel = row + std::min(bx * 4 + x, width - 1) * channels;
+				for (int c = 0; c < keep; c++)
+					texels[(y * 4 + x) * keep + c] = texel[c];
+			}
+		}
+	}
+
+	uint16_t to565(float b, float g, float r)
+	{
+		int r5 = (int)std::lround(std::min(std::max(r, 0.0f), 255.0f) * 31.0f / 255.0f);
+		int g6 = (int)std::lround(std::min(std::max(g, 0.0f), 255.0f) * 63.0f / 255.0f);
+		int b5 = (int)std::lround(std::min(std::max(b, 0.0f), 255.0f) * 31.0f / 255.0f);
+		return (uint16_t)((r5 << 11) | (g6 << 5) | b5);
+	}
+
+	//BGR, bits replicated into the low end like the hardware does
+	void from565(uint16_t c, int* bgr)
+	{
+		int r5 = (c >> 11) & 31, g6 = (c >> 5) & 63, b5 = c & 31;
+		bgr[0] = (b5 << 3) | (b5 >> 2);
+		bgr[1] = (g6 << 2) | (g6 >> 4);
+		bgr[2] = (r5 << 3) | (r5 >> 2);
+	}
+
+	//the encoders pick a step along the endpoint line, these map it to the format's index order
+	const unsigned char BC4_INDEX[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };	//step 0 is the low endpoint
+	const unsigned char BC1_INDEX[4] = { 0, 2, 3, 1 };				//step 0 is color0
+}
+
+void BlockCompressor::encodeBC4Block(const unsigned char texels[16], unsigned char* block)
+{
+	int lo, hi;
+	unsigned char steps[16];
+#ifdef BLOCK_COMPRESSOR_SSE2
+	__m128i v = _mm_loadu_si128((const __m128i*)texels);
+	__m128i m = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+	m = _mm_min_epu8(m, _mm_srli_si128(m, 4));
+	m = _mm_min_epu8(m, _mm_srli_si128(m, 2));
+	m = _mm_min_epu8(m, _mm_srli_si128(m, 1));
+	__m128i M = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+	M = _mm_max_epu8(M, _mm_srli_si128(M, 4));
+	M = _mm_max_epu8(M, _mm_srli_si128(M, 2));
+	M = _mm_max_epu8(M, _mm_srli_si128(M, 1));
+	lo = _mm_cvtsi128_si32(m) & 0xff;
+	hi = _mm_cvtsi128_si32(M) & 0xff;
+#else
+	lo = hi = texels[0];
+	for (int i = 1; i < 16; i++)
+	{
+		lo = std::min(lo, (int)texels[i]);
+		hi = std::max(hi, (int)texels[i]);
+	}
+#endif
+
+	//red0 > red1 selects the 8 value mode, equal endpoints decode every index 0 to red0
+	block[0] = (unsigned char)hi;
+	block[1] = (unsigned char)lo;
+	if (hi == lo)
+	{
+		memset(block + 2, 0, 6);
+		return;
+	}
+
+	//the palette is evenly spaced, so the nearest entry is the rounded step from lo
+	float scale = 7.0f / (float)(hi - lo);
+#ifdef BLOCK_COMPRESSOR_SSE2
+	__m128i zero = _mm_setzero_si128();
+	__m128i low = _mm_set1_epi32(lo);
+	__m128 scales = _mm_set1_ps(scale);
+	__m128i words[2] = { _mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero) };
+	__m128i quads[4];
+	for (int i = 0; i < 4; i++)
+	{
+		__m128i dwords = (i & 1) ? _mm_unpackhi_epi16(words[i / 2], zero) : _mm_unpacklo_epi16(words[i / 2], zero);
+		__m128 distance = _mm_cvtepi32_ps(_mm_sub_epi32(dwords, low));
+		quads[i] = _mm_cvtps_epi32(_mm_mul_ps(distance, scales));
+	}
+	__m128i packed = _mm_packus_epi16(_mm_packs_epi32(quads[0], quads[1]), _mm_packs_epi32(quads[2], quads[3]));
+	_mm_storeu_si128((__m128i*)steps, _mm_min_epu8(packed, _mm_set1_epi8(7)));
+#else
+	//nearbyint rounds half to even like _mm_cvtps_epi32, so both paths pick the same steps
+	for (int i = 0; i < 16; i++)
+		steps[i] = (unsigned char)std::min((int)std::nearbyint((texels[i] - lo) * scale), 7);
+#endif
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= (uint64_t)BC4_INDEX[steps[i]] << (3 * i);
+	for (int i = 0; i < 6; i++)
+		block[2 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+void BlockCompressor::encodeBC1Block(const unsigned char texels[16 * 3], unsigned char* block)
+{
+	//structure of arrays so four texels go through the projection at once
+	alignas(16) float channel[3][16];
+	float lo[3] = { 255.0f, 255.0f, 255.0f }, hi[3] = { 0.0f, 0.0f, 0.0f }, mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			float value = texels[i * 3 + c];
+			channel[c][i] = value;
+			lo[c] = std::min(lo[c], value);
+			hi[c] = std::max(hi[c], value);
+			mean[c] += value / 16.0f;
+		}
+	}
+
+	//bounding box shrunk a little, then the diagonal that follows the colours is picked
+	//from the sign of the covariance of blue and red against green
+	float covariance[2] = { 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		float green = channel[1][i] - mean[1];
+		covariance[0] += (channel[0][i] - mean[0]) * green;
+		covariance[1] += (channel[2][i] - mean[2]) * green;
+	}
+	for (int c = 0; c < 3; c++)
+	{
+		float inset = (hi[c] - lo[c]) / 16.0f;
+		lo[c] += inset;
+		hi[c] -= inset;
+	}
+	if (covariance[0] < 0.0f)
+		std::swap(lo[0], hi[0]);
+	if (covariance[1] < 0.0f)
+		std::swap(lo[2], hi[2]);
+
+	uint16_t color0 = to565(hi[0], hi[1], hi[2]);
+	uint16_t color1 = to565(lo[0], lo[1], lo[2]);
+	//color0 > color1 is the opaque 4 colour mode
+	if (color0 < color1)
+		std::swap(color0, color1);
+	block[0] = (unsigned char)(color0 & 0xff);
+	block[1] = (unsigned char)(color0 >> 8);
+	block[2] = (unsigned char)(color1 & 0xff);
+	block[3] = (unsigned char)(color1 >> 8);
+	if (color0 == color1)
+	{
+		memset(block + 4, 0, 4);
+		return;
+	}
+
+	int end0[3], end1[3];
+	from565(color0, end0);
+	from565(color1, end1);
+	float direction[3], length = 0.0f;
+	for (int c = 0; c < 3; c++)
+	{
+		direction[c] = (float)(end1[c] - end0[c]);
+		length += direction[c] * direction[c];
+	}
+	//projection onto color0 -> color1, in thirds
+	for (int c = 0; c < 3; c++)
+		direction[c] *= 3.0f / length;
+
+	int steps[16];
+#ifdef BLOCK_COMPRESSOR_SSE2
+	for (int i = 0; i < 16; i += 4)
+	{
+		__m128 t = _mm_setzero_ps();
+		for (int c = 0; c < 3; c++)
+		{
+			__m128 offset = _mm_sub_ps(_mm_load_ps(&channel[c][i]), _mm_set1_ps((float)end0[c]));
+			t = _mm_add_ps(t, _mm_mul_ps(offset, _mm_set1_ps(direction[c])));
+		}
+		t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(3.0f));
+		_mm_storeu_si128((__m128i*)&steps[i], _mm_cvtps_epi32(t));
+	}
+#else
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (int c = 0; c < 3; c++)
+			t += (channel[c][i] - end0[c]) * direction[c];
+		steps[i] = (int)std::nearbyint(std::min(std::max(t, 0.0f), 3.0f));
+	}
+#endif
+
+	uint32_t bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= (uint32_t)BC1_INDEX[steps[i]] << (2 * i);
+	for (int i = 0; i < 4; i++)
+		block[4 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+std::vector<unsigned char> BlockCompressor::compressBC4(const unsigned char* pixels, int width, int height, size_t stride, ThreadPool* pool)
+{
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	std::vector<unsigned char> blocks(compressedSize(width, height));
+	pool->parallelFor(0, blocksY, [&](int begin, int end)
+	{
+		unsigned char texels[16];
+		for (int by = begin; by < end; by++)
+		{
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				fetchBlock(pixels, width, height, stride, 1, bx, by, 1, texels);
+				encodeBC4Block(texels, &blocks[(by * blocksX + bx) * BLOCK_BYTES]);
+			}
+		}
+	});
+	return blocks;
+}
+
+std::vector<unsigned char> BlockCompressor::compressBC1(const unsigned char* pixels, int width, int height, size_t stride, int channels, ThreadPool* pool)
+{
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	std::vector<unsigned char> blocks(compressedSize(width, height));
+	pool->parallelFor(0, blocksY, [&](int begin, int end)
+	{
+		unsigned char texels[16 * 3];
+		for (int by = begin; by < end; by++)
+		{
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				fetchBlock(pixels, width, height, stride, channels, bx, by, 3, texels);
+				encodeBC1Block(texels, &blocks[(by * blocksX + bx) * BLOCK_BYTES]);
+			}
+		}
+	});
+	return blocks;
+}
+
+void BlockCompressor::decodeBC4Block(const unsigned char* block, unsigned char texels[16])
+{
+	int red0 = block[0], red1 = block[1];
+	int palette[8] = { red0, red1 };
+	if (red0 > red1)
+	{
+		for (int i = 1; i < 7; i++)
+			palette[i + 1] = ((7 - i) * red0 + i * red1 + 3) / 7;
+	}
+	else
+	{
+		for (int i = 1; i < 5; i++)
+			palette[i + 1] = ((5 - i) * red0 + i * red1 + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+	uint64_t bits = 0;
+	for (int i = 0; i < 6; i++)
+		bits |= (uint64_t)block[2 + i] << (8 * i);
+	for (int i = 0; i < 16; i++)
+		texels[i] = (unsigned char)palette[(bits >> (3 * i)) & 7];
+}
+
+void BlockCompressor::decodeBC1Block(const unsigned char* block, unsigned char texels[16 * 3])
+{
+	uint16_t color0 = (uint16_t)(block[0] | (block[1] << 8));
+	uint16_t color1 = (uint16_t)(block[2] | (block[3] << 8));
+	int palette[4][3];
+	from565(color0, palette[0]);
+	from565(color1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		if (color0 > color1)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	uint32_t bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+			texels[i * 3 + c] = (unsigned char)palette[(bits >> (2 * i)) & 3][c];
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "Utilities/ThreadPool.h"
+
+//CPU encoders for the block compressed formats the asset packer writes.
+//Images are cut into 4x4 blocks (edges repeat the last row/column), block rows are
+//split over the thread pool and the per block math uses SSE2 where it is available
+//
+//BC4 / RGTC1: one channel, 8 bytes per block, used for the heightmap frames
+//BC1 / DXT1: opaque colour, 8 bytes per block, used for the colour images and the skybox
+class BlockCompressor
+{
+public:
+	static const int BLOCK_BYTES = 8;
+
+	//8 bit single channel rows, stride in bytes
+	static std::vector<unsigned char> compressBC4(const unsigned char* pixels, int width, int height, size_t stride, ThreadPool* pool = &ThreadPool::shared());
+	//8 bit BGR or BGRA rows like OpenCV decodes them, alpha is ignored
+	static std::vector<unsigned char> compressBC1(const unsigned char* pixels, int width, int height, size_t stride, int channels, ThreadPool* pool = &ThreadPool::shared());
+
+	static size_t compressedSize(int width, int height)
+	{
+		return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BLOCK_BYTES;
+	}
+
+	//reference decoders, the packer uses them to report the error
+	static void decodeBC4Block(const unsigned char* block, unsigned char texels[16]);
+	static void decodeBC1Block(const unsigned char* block, unsigned char texels[16 * 3]);
+
+private:
+	static void encodeBC4Block(const unsigned char texels[16], unsigned char* block);
+	static void encodeBC1Block(const unsigned char texels[16 * 3], unsigned char* block);
+};
@@ -141,6 +141,12 @@ void runButtonCB(TrainWindow* tw)
 			tw->damageMe();
 		}
 	}
+	//keep drawing while images are still loading or programs compiling so they show up as they arrive,
+	//and while the tessellation benchmark flies its camera
+	else if ((ImageLoader::shared().pending() > 0 || tw->trainView->shadersPending || tw->tessBench->value()) && clock() - lastRedraw > CLOCKS_PER_SEC/60) {
+		lastRedraw = clock();
+		tw->damageMe();
+	}
 	Sleep(1);
 }
 
@@ -249,3 +255,13 @@ void rmzCB(Fl_Widget*, TrainWindow* tw)
 	rollz(tw, -1);
 }
 
+//***************************************************************************
+//
+// * Pick a new random Gerstner wave set with the same settings
+//===========================================================================
+void rerollWavesCB(Fl_Widget*, TrainWindow* tw)
+//===========================================================================
+{
+	tw->trainView->waveSeed++;
+	tw->damageMe();
+}
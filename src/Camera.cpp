@@ -0,0 +1,62 @@
+#include "Camera.h"
+
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/transform.hpp>
+
+void Camera::update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& eye)
+{
+	this->main.view = view;
+	this->main.projection = projection;
+	this->main.skyProjection = projection;
+	this->eye = eye;
+
+	const glm::vec3& n = this->planeNormal;
+	float d = -glm::dot(n, this->planePoint);
+	//the passes keep the field of view of the main camera
+	float fov = 2.0f * std::atan(1.0f / projection[1][1]);
+	glm::mat4 square = glm::perspective(fov, 1.0f, this->passNear, this->passFar);
+
+	//mirror about the plane, the near plane is tilted onto the water so nothing under it reflects
+	glm::mat4 mirror;
+	mirror[0][0] = -2 * n.x * n.x + 1;
+	mirror[0][1] = -2 * n.x * n.y;
+	mirror[0][2] = -2 * n.x * n.z;
+	mirror[0][3] = -2 * n.x * d;
+	mirror[1][0] = -2 * n.x * n.y;
+	mirror[1][1] = -2 * n.y * n.y + 1;
+	mirror[1][2] = -2 * n.y * n.z;
+	mirror[1][3] = -2 * n.y * d;
+	mirror[2][0] = -2 * n.z * n.x;
+	mirror[2][1] = -2 * n.z * n.y;
+	mirror[2][2] = -2 * n.z * n.z + 1;
+	mirror[2][3] = -2 * n.z * d;
+	mirror[3][0] = 0;
+	mirror[3][1] = 0;
+	mirror[3][2] = 0;
+	mirror[3][3] = 1;
+	this->reflect.view = view * mirror;
+	this->reflect.skyProjection = square;
+	glm::mat4 oblique = square;
+	glm::vec4 plane = glm::transpose(glm::inverse(this->reflect.view)) * glm::vec4(n, d);
+	glm::vec4 q = glm::vec4((glm::sign(plane.x) + oblique[2][0]) / oblique[0][0],
+		(glm::sign(plane.y) + oblique[2][1]) / oblique[1][1],
+		-1.0f, (1.0f + oblique[2][2]) / oblique[3][2]);
+	glm::vec4 c = plane * (2.0f / glm::dot(plane, q));
+	oblique[0][2] = c.x;
+	oblique[1][2] = c.y;
+	oblique[2][2] = c.z + 1.0f;
+	oblique[3][2] = c.w;
+	this->reflect.projection = oblique;
+
+	//squash the scene under the water towards it, clipped at the plane the same way
+	this->refract.view = view * glm::scale(glm::vec3(1, glm::clamp(this->refractScale, 0.001f, 1.0f), 1));
+	this->refract.skyProjection = square;
+	oblique = square;
+	plane = glm::transpose(glm::inverse(this->refract.view)) * glm::vec4(n, d);
+	oblique[0][2] = plane.x + oblique[0][3];
+	oblique[1][2] = plane.y + oblique[1][3];
+	oblique[2][2] = plane.z + oblique[2][3];
+	oblique[3][2] = plane.w + oblique[3][3];
+	this->refract.projection = oblique;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <glm/glm.hpp>
+
+//Matrices of every view a frame draws with, worked out in glm once per frame so nothing reads
+//them back from the fixed-function stack. The reflection and refraction passes look at the
+//scene mirrored and squashed by the water plane, with the near plane moved onto the water
+class Camera
+{
+public:
+	struct Pass
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		//projection without the water clip plane, the sky box is drawn with it
+		glm::mat4 skyProjection;
+	};
+
+	//sets the main view of the frame and recomputes the reflection and refraction passes
+	void update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& eye);
+
+	Pass main;
+	Pass reflect;
+	Pass refract;
+	glm::vec3 eye;
+
+	//the water, reflected about and refracted through
+	glm::vec3 planePoint = glm::vec3(-200, 0, 200);
+	glm::vec3 planeNormal = glm::vec3(0, 1, 0);
+	//the reflection and refraction textures are square
+	float passNear = 0.01f;
+	float passFar = 1000.0f;
+	//how much the refraction squashes the scene under the water
+	float refractScale = 0.7f;
+};
@@ -0,0 +1,118 @@
+#include "DropBins.h"
+
+#include <cmath>
+
+namespace
+{
+	//constants of the ripple profile in getSimCoord:
+	//1.5 * A * sin(...) / exp(0.1 * |dist - t_c| + 0.05 * t_c), dist = |uv - drop| / wavelength * 30, t_c = age * 2pi * 5
+	const float PEAK = 1.5f;
+	const float RING_FALLOFF = 0.1f;
+	const float AGE_FALLOFF = 0.05f;
+	const float DIST_SCALE = 30.0f;
+	const float TIME_SCALE = 2.0f * 3.14159265358979f * 5.0f;
+	//the normal samples the profile this far from the vertex
+	const float NORMAL_DELTA = 0.0001f;
+}
+
+DropBins::DropBins(int gridSize) :
+	gridSize(gridSize)
+{
+	this->cells.resize(gridSize * gridSize);
+}
+
+float DropBins::lifetime(float amplitude) const
+{
+	if (amplitude * PEAK <= this->threshold)
+		return 0.0f;
+	return std::log(amplitude * PEAK / this->threshold) / AGE_FALLOFF / TIME_SCALE;
+}
+
+void DropBins::build(const DropRing& drops, float time, float wavelength, float amplitude)
+{
+	const int n = this->gridSize;
+	this->liveCount = 0;
+	this->entries.clear();
+	std::fill(this->cells.begin(), this->cells.end(), glm::ivec2(0));
+
+	for (int i = 0; i < drops.size(); i++)
+	{
+		const DropRing::Drop& drop = drops.at(i);
+		float peak = amplitude * drop.amplitude * PEAK;
+		if (peak <= this->threshold)
+			continue;
+		float budget = std::log(peak / this->threshold);
+		float tc = (time - drop.startTime) * TIME_SCALE;
+		//|dist - t_c| has to stay below this for the ripple to be visible
+		float ring = (budget - AGE_FALLOFF * tc) / RING_FALLOFF;
+		//the profile is flat until the drop is older than 0
+		if (tc <= 0.0f || ring < 0.0f)
+			continue;
+		float outer = (tc + ring) * wavelength / DIST_SCALE + NORMAL_DELTA;
+		float inner = glm::max((tc - ring) * wavelength / DIST_SCALE - NORMAL_DELTA, 0.0f);
+
+		int dropSlot = drops.slot(i);
+		this->liveCount++;
+
+		const glm::vec2& p = drop.position;
+		int x0 = glm::clamp((int)std::floor((p.x - outer) * n), 0, n - 1);
+		int x1 = glm::clamp((int)std::floor((p.x + outer) * n), 0, n - 1);
+		int y0 = glm::clamp((int)std::floor((p.y - outer) * n), 0, n - 1);
+		int y1 = glm::clamp((int)std::floor((p.y + outer) * n), 0, n - 1);
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int x = x0; x <= x1; x++)
+			{
+				//closest and farthest point of the cell, skip cells that miss the annulus
+				glm::vec2 low(x / (float)n, y / (float)n);
+				glm::vec2 high((x + 1) / (float)n, (y + 1) / (float)n);
+				float nearest = glm::length(glm::clamp(p, low, high) - p);
+				float farthest = glm::length(glm::max(glm::abs(p - low), glm::abs(p - high)));
+				if (nearest > outer || farthest < inner)
+					continue;
+				this->entries.push_back({ y * n + x, dropSlot });
+				this->cells[y * n + x].y++;
+			}
+		}
+	}
+
+	//counting sort of the entries by cell
+	int offset = 0;
+	for (glm::ivec2& cell : this->cells)
+	{
+		cell.x = offset;
+		offset += cell.y;
+		cell.y = 0;
+	}
+	this->indices.resize(this->entries.size());
+	for (const Entry& entry : this->entries)
+	{
+		glm::ivec2& cell = this->cells[entry.cell];
+		this->indices[cell.x + cell.y] = entry.drop;
+		cell.y++;
+	}
+}
+
+//the buffers only grow, empty lists still get one element so the binding stays valid
+void DropBins::upload(GLuint& buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr size)
+{
+	if (!buffer)
+		glGenBuffers(1, &buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	if (size > capacity || capacity == 0)
+	{
+		capacity = glm::max(size, (GLsizeiptr)sizeof(glm::vec4));
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, NULL, GL_DYNAMIC_DRAW);
+	}
+	if (size > 0)
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+}
+
+void DropBins::bind()
+{
+	this->upload(this->buffers[0], this->capacities[0], this->cells.data(), this->cells.size() * sizeof(glm::ivec2));
+	this->upload(this->buffers[1], this->capacities[1], this->indices.data(), this->indices.size() * sizeof(int));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	for (int i = 0; i < 2; i++)
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2 + i, this->buffers[i]);
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "DropRing.h"
+
+//Buckets the analytic ripple drops into a uniform grid over texture space so the
+//shader only sums the drops that can reach its cell. A drop reaches the points
+//where its ripple is still above threshold, an annulus that widens and thins with age
+class DropBins
+{
+public:
+	DropBins(int gridSize = 16);
+
+	//the index lists hold ring slots, wavelength is the waveLen slider in texture units
+	void build(const DropRing& drops, float time, float wavelength, float amplitude);
+	//uploads cell ranges and indices to shader storage bindings 2 and 3, the ring itself goes to 1
+	void bind();
+
+	//age after which a drop is below threshold everywhere
+	float lifetime(float amplitude) const;
+
+	int getGridSize() const { return this->gridSize; }
+	int getLiveCount() const { return this->liveCount; }
+	int getIndexCount() const { return (int)this->indices.size(); }
+	//what bind() uploads, for reading the bins on the CPU
+	const std::vector<glm::ivec2>& getCells() const { return this->cells; }
+	const std::vector<int>& getIndices() const { return this->indices; }
+
+	//ripple height below which a drop is left out, in the units evaluateWave adds to the world position
+	//(u_model's y scale is not applied to it), while the cells it decides on are in texture space
+	float threshold = 0.01f;
+
+private:
+	struct Entry
+	{
+		int cell;
+		int drop;
+	};
+
+	void upload(GLuint& buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr size);
+
+	int gridSize;
+	int liveCount = 0;
+	std::vector<glm::ivec2> cells;		//offset, count into indices
+	std::vector<int> indices;
+	std::vector<Entry> entries;
+
+	GLuint buffers[2] = { 0, 0 };
+	GLsizeiptr capacities[2] = { 0, 0 };
+};
@@ -0,0 +1,72 @@
+#include "DropRing.h"
+
+DropRing::DropRing(int capacity)
+{
+	this->drops.resize(glm::max(capacity, 1));
+}
+
+void DropRing::setCapacity(int capacity)
+{
+	capacity = glm::max(capacity, 1);
+	if (capacity == (int)this->drops.size())
+		return;
+	int keep = glm::min(this->count, capacity);
+	std::vector<Drop> resized(capacity);
+	for (int i = 0; i < keep; i++)
+		resized[i] = this->at(this->count - keep + i);
+	this->drops.swap(resized);
+	this->head = 0;
+	this->count = keep;
+	this->dirty = true;
+}
+
+void DropRing::push(const glm::vec2& position, float startTime, float amplitude)
+{
+	int capacity = (int)this->drops.size();
+	if (this->count == capacity)
+	{
+		this->head = (this->head + 1) % capacity;
+		this->count--;
+	}
+	this->drops[this->slot(this->count)] = { position, startTime, amplitude };
+	this->count++;
+	this->dirty = true;
+}
+
+void DropRing::popOldest()
+{
+	if (this->count == 0)
+		return;
+	this->head = (this->head + 1) % (int)this->drops.size();
+	this->count--;
+}
+
+void DropRing::clear()
+{
+	this->head = 0;
+	this->count = 0;
+	this->dirty = true;
+}
+
+void DropRing::bind(GLuint binding)
+{
+	if (!this->buffer)
+		glGenBuffers(1, &this->buffer);
+	GLsizeiptr size = this->drops.size() * sizeof(Drop);
+	if (size != this->bufferSize)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+		this->bufferSize = size;
+		this->dirty = true;
+	}
+	//the whole array in one call, slots outside the live window are never indexed
+	if (this->dirty)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, this->drops.data());
+		this->dirty = false;
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, this->buffer);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+//Fixed capacity ring of analytic ripple drops, the oldest drop is overwritten when
+//full. The records live in one array that goes to the GPU with a single upload,
+//nothing is allocated per frame or per drop once the capacity is set
+class DropRing
+{
+public:
+	//std430 layout of drop_data in waveFunctions.glsl
+	struct Drop
+	{
+		glm::vec2 position;		//texture space
+		float startTime;
+		float amplitude;		//scales u_amplitude
+	};
+
+	DropRing(int capacity = 100);
+
+	//keeps the newest drops that still fit
+	void setCapacity(int capacity);
+	int getCapacity() const { return (int)this->drops.size(); }
+
+	void push(const glm::vec2& position, float startTime, float amplitude = 1.0f);
+	void popOldest();
+	void clear();
+
+	int size() const { return this->count; }
+	bool empty() const { return this->count == 0; }
+	//i-th live drop counted from the oldest, and the array slot it lives in
+	int slot(int i) const { return (this->head + i) % (int)this->drops.size(); }
+	const Drop& at(int i) const { return this->drops[this->slot(i)]; }
+	const Drop& oldest() const { return this->at(0); }
+	//the drop in an array slot, DropBins lists slots
+	const Drop& inSlot(int slot) const { return this->drops[slot]; }
+
+	//uploads the array if it changed and binds it to shader storage binding 1
+	void bind(GLuint binding = 1);
+
+private:
+	std::vector<Drop> drops;
+	int head = 0;
+	int count = 0;
+
+	bool dirty = true;
+	GLuint buffer = 0;
+	GLsizeiptr bufferSize = 0;
+};
@@ -0,0 +1,112 @@
+#include "GpuWaveSolver.h"
+
+GpuWaveSolver::GpuWaveSolver(int resolution) :
+	resolution(resolution)
+{
+}
+
+void GpuWaveSolver::addImpulse(const glm::vec2& uv, float strength, float radius)
+{
+	this->impulses.push_back(glm::vec4(uv, strength, radius));
+}
+
+void GpuWaveSolver::generate()
+{
+	this->impulseShader = new Shader("../../src/shaders/waveImpulse.comp");
+	this->stepShader = new Shader("../../src/shaders/waveStep.comp");
+	this->slopeShader = new Shader("../../src/shaders/waveSlope.comp");
+	//set on every step, resolved once
+	this->hasImpulseUniform = this->stepShader->uniform<int>("u_hasImpulse");
+	this->courantUniform = this->stepShader->uniform<float>("u_courant");
+	this->dampingUniform = this->stepShader->uniform<float>("u_damping");
+
+	for (int i = 0; i < 2; i++)
+	{
+		this->state[i] = new Texture2D(this->resolution, this->resolution, GL_RG32F, GL_RG, GL_FLOAT);
+		this->state[i]->clear();
+	}
+	this->bump = new Texture2D(this->resolution, this->resolution, GL_R32I, GL_RED_INTEGER, GL_INT);
+	this->bump->clear();
+	this->heightSlope = new Texture2D(this->resolution, this->resolution, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+	this->heightSlope->clear();
+
+	glGenBuffers(1, &this->impulseBuffer);
+}
+
+void GpuWaveSolver::update()
+{
+	if (!this->stepShader)
+	{
+		this->generate();
+	}
+	if (this->pendingSteps == 0)
+	{
+		return;
+	}
+	//the rest is carried over, the simulation catches up over the next frames
+	int steps = glm::min(this->pendingSteps, this->maxStepsPerFrame);
+	this->pendingSteps -= steps;
+
+	GLuint groups = (this->resolution + 15) / 16;
+	//per step, the impulse splat of the first step included, the slope pass is not
+	this->timer.begin();
+	for (int i = 0; i < steps; i++)
+	{
+		bool hasImpulse = (i == 0) && !this->impulses.empty();
+		if (hasImpulse)
+		{
+			//the buffer only grows, there is no cap on the amount of drops per frame
+			GLsizeiptr size = this->impulses.size() * sizeof(glm::vec4);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->impulseBuffer);
+			if (size > this->impulseBufferSize)
+			{
+				glBufferData(GL_SHADER_STORAGE_BUFFER, size, this->impulses.data(), GL_DYNAMIC_DRAW);
+				this->impulseBufferSize = size;
+			}
+			else
+			{
+				glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, this->impulses.data());
+			}
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, this->impulseBuffer);
+
+			//enough 16x16 tiles for the widest footprint of the batch, 3 radii each side
+			float radius = 0.0f;
+			for (const glm::vec4& impulse : this->impulses)
+				radius = glm::max(radius, impulse.w);
+			int reach = (int)glm::ceil(glm::max(radius * this->resolution, 1.0f) * 3.0f);
+			GLuint tiles = (GLuint)(2 * reach + 1 + 15) / 16;
+
+			this->impulseShader->Use();
+			this->bump->bindImage(2, GL_READ_WRITE, GL_R32I);
+			glDispatchCompute(tiles, tiles, (GLuint)this->impulses.size());
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+			this->impulses.clear();
+		}
+
+		this->stepShader->Use();
+		this->stepShader->set(this->hasImpulseUniform, (int)hasImpulse);
+		this->stepShader->set(this->courantUniform, this->courant);
+		this->stepShader->set(this->dampingUniform, this->damping);
+		this->state[this->current]->bindImage(0, GL_READ_ONLY, GL_RG32F);
+		this->state[1 - this->current]->bindImage(1, GL_WRITE_ONLY, GL_RG32F);
+		this->bump->bindImage(2, GL_READ_ONLY, GL_R32I);
+		glDispatchCompute(groups, groups, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+		this->current = 1 - this->current;
+
+		if (hasImpulse)
+		{
+			this->bump->clear();
+		}
+	}
+	this->timer.end(steps);
+
+	this->slopeShader->Use();
+	this->state[this->current]->bindImage(0, GL_READ_ONLY, GL_RG32F);
+	this->heightSlope->bindImage(1, GL_WRITE_ONLY, GL_RGBA16F);
+	glDispatchCompute(groups, groups, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	glUseProgram(0);
+}
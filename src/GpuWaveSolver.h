@@ -0,0 +1,52 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "RenderUtilities/GpuTimer.h"
+#include "RenderUtilities/Shader.h"
+#include "RenderUtilities/Texture.h"
+
+//GL 4.3 compute version of WaveSolver, the heightfield lives in two ping-pong
+//RG32F textures (height now, height one step ago) and the result is written to
+//an RGBA16F height/slope texture with the same layout as the CPU solver
+class GpuWaveSolver
+{
+public:
+	GpuWaveSolver(int resolution = 256);
+
+	//radius in texture space, the bump covers 3 radii around uv like on the CPU
+	void addImpulse(const glm::vec2& uv, float strength = 1.0f, float radius = 0.01f);
+	//called from the tick, the steps are run in the next update() on the GL thread
+	void requestStep() { this->pendingSteps++; }
+	void update();
+
+	Texture2D* getHeightSlope() { return this->heightSlope; }
+	int getResolution() const { return this->resolution; }
+
+	float courant = 0.25f;
+	float damping = 0.996f;
+	//never catch up more than this many ticks in one frame, the rest waits for the next
+	int maxStepsPerFrame = 4;
+
+	GpuTimer timer = GpuTimer("GPU ripple step");
+
+private:
+	void generate();
+
+	int resolution;
+	int pendingSteps = 0;
+	int current = 0;
+	std::vector<glm::vec4> impulses;
+
+	Shader* impulseShader = nullptr;
+	Shader* stepShader = nullptr;
+	Shader* slopeShader = nullptr;
+	Shader::Uniform<int> hasImpulseUniform;
+	Shader::Uniform<float> courantUniform;
+	Shader::Uniform<float> dampingUniform;
+	Texture2D* state[2] = { nullptr, nullptr };
+	Texture2D* bump = nullptr;
+	Texture2D* heightSlope = nullptr;
+	GLuint impulseBuffer = 0;
+	GLsizeiptr impulseBufferSize = 0;
+};
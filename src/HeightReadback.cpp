@@ -0,0 +1,187 @@
+#include "HeightReadback.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "RenderUtilities/Texture.h"
+
+namespace
+{
+	double elapsedMs(std::chrono::high_resolution_clock::time_point since)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - since).count();
+	}
+}
+
+HeightReadback::HeightReadback(int ringSize) :
+	ring(ringSize < 2 ? 2 : ringSize)
+{
+}
+
+HeightReadback::~HeightReadback()
+{
+	for (Slot& slot : this->ring)
+	{
+		this->release(slot);
+		glDeleteBuffers(1, &slot.buffer);
+	}
+	glDeleteTextures(1, &this->image);
+	delete this->shader;
+}
+
+Shader* HeightReadback::getShader()
+{
+	if (!this->shader)
+	{
+		this->shader = new Shader("../../src/shaders/surfaceReadback.comp");
+	}
+	return this->shader;
+}
+
+void HeightReadback::release(Slot& slot)
+{
+	if (slot.fence)
+		glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+}
+
+void HeightReadback::capture(int resolution, float time)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	this->frame++;
+	this->captures++;
+	this->poll();
+
+	if (resolution != this->resolution)
+	{
+		for (Slot& slot : this->ring)
+			this->release(slot);
+		glDeleteTextures(1, &this->image);
+		glGenTextures(1, &this->image);
+		glActiveTexture(GL_TEXTURE0 + Texture2D::UPLOAD_UNIT);
+		glBindTexture(GL_TEXTURE_2D, this->image);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, resolution, resolution);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		//the buffers are sized with the image, a capture only copies into them
+		GLsizeiptr size = (GLsizeiptr)resolution * resolution * 4 * sizeof(float);
+		for (Slot& slot : this->ring)
+		{
+			if (!slot.buffer)
+				glGenBuffers(1, &slot.buffer);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+			glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		this->resolution = resolution;
+	}
+
+	//the oldest buffer is still in flight, the GPU is behind by the whole ring
+	Slot& slot = this->ring[this->head];
+	if (slot.fence)
+	{
+		this->skipped++;
+		this->cpuMs += elapsedMs(start);
+		return;
+	}
+
+	this->timer.begin();
+	this->getShader()->Use();
+	glBindImageTexture(0, this->image, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+	GLuint groups = (resolution + 15) / 16;
+	glDispatchCompute(groups, groups, 1);
+	glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+	//the copy only lands in the buffer, nothing waits for it here
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	glActiveTexture(GL_TEXTURE0 + Texture2D::UPLOAD_UNIT);
+	glBindTexture(GL_TEXTURE_2D, this->image);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	this->timer.end();
+
+	slot.frame = this->frame;
+	slot.time = time;
+	slot.issued = std::chrono::high_resolution_clock::now();
+	this->head = (this->head + 1) % (int)this->ring.size();
+	this->cpuMs += elapsedMs(start);
+}
+
+void HeightReadback::poll()
+{
+	//the GPU finishes in order, so the newest passed fence has only passed ones before it
+	const int n = (int)this->ring.size();
+	int newest = -1;
+	for (int i = 0; i < n; i++)
+	{
+		Slot& slot = this->ring[(this->head + i) % n];
+		if (!slot.fence)
+			continue;
+		GLint status = GL_UNSIGNALED;
+		glGetSynciv(slot.fence, GL_SYNC_STATUS, 1, nullptr, &status);
+		if (status != GL_SIGNALED)
+			break;
+		newest = (this->head + i) % n;
+	}
+	if (newest < 0)
+		return;
+
+	//older copies are already superseded, only the newest is mapped
+	for (int i = 0; i < n; i++)
+	{
+		int index = (this->head + i) % n;
+		Slot& slot = this->ring[index];
+		if (!slot.fence)
+			continue;
+		this->release(slot);
+		if (index != newest)
+			continue;
+
+		size_t count = (size_t)this->resolution * this->resolution * 4;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(float), GL_MAP_READ_BIT);
+		if (data)
+		{
+			this->latest.resize(count);
+			memcpy(this->latest.data(), data, count * sizeof(float));
+			this->latestResolution = this->resolution;
+			this->latestTime = slot.time;
+			this->latestFrame = slot.frame;
+
+			this->copies++;
+			this->latencyFrames += this->frame - slot.frame;
+			this->latencyMs += elapsedMs(slot.issued);
+			this->bytes += count * sizeof(float);
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		break;
+	}
+}
+
+void HeightReadback::report(int every)
+{
+	this->timer.report(every);
+	if (this->captures < every)
+		return;
+	double seconds = elapsedMs(this->reportStart) / 1000.0;
+	if (this->copies > 0)
+	{
+		std::cout << "Height readback: " << this->latestResolution << "x" << this->latestResolution << ", "
+			<< (double)this->latencyFrames / this->copies << " frames / " << this->latencyMs / this->copies << " ms late, "
+			<< this->bytes / (1024.0 * 1024.0) / seconds << " MB/s, ";
+	}
+	else
+		std::cout << "Height readback: nothing arrived, ";
+	std::cout << this->skipped << " of " << this->captures << " frames skipped, "
+		<< this->cpuMs / this->captures << " ms CPU per frame" << std::endl;
+	this->copies = 0;
+	this->captures = 0;
+	this->skipped = 0;
+	this->latencyFrames = 0;
+	this->latencyMs = 0.0;
+	this->cpuMs = 0.0;
+	this->bytes = 0;
+	this->reportStart = std::chrono::high_resolution_clock::now();
+}
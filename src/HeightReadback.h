@@ -0,0 +1,75 @@
+#pragma once
+#include <glad/glad.h>
+#include <chrono>
+#include <vector>
+
+#include "RenderUtilities/GpuTimer.h"
+#include "RenderUtilities/Shader.h"
+
+//Copies the surface to the CPU without stalling: each frame the selected wave model is
+//evaluated into a small RGBA32F image (normal, height), which goes into the next pixel pack
+//buffer of a ring behind a fence. Fences are only polled, a copy is read once its fence has
+//passed, so the CPU sees the surface a few frames late. When every buffer is still in flight
+//the frame is skipped instead of waited for
+class HeightReadback
+{
+public:
+	HeightReadback(int ringSize = 3);
+	~HeightReadback();
+
+	//compiled on first use, the caller sets the wave uniforms on it before capture()
+	Shader* getShader();
+	//evaluates the surface at resolution x resolution and queues the copy, time is what the
+	//wave uniforms were set to. A new resolution drops the copies in flight
+	void capture(int resolution, float time);
+	//reads back the newest copy whose fence has passed, never waits
+	void poll();
+
+	//newest completed copy, (normal.xyz, height) per texel with v = 0 on the z = 100 side
+	//like the surface texture, nullptr until the first copy arrived
+	const float* getNormalHeight() const { return this->latest.empty() ? nullptr : this->latest.data(); }
+	int getResolution() const { return this->latestResolution; }
+	//wave time of the copy and how many captures ago it was made
+	float getTime() const { return this->latestTime; }
+	int getLatency() const { return this->frame - this->latestFrame; }
+
+	//print latency, throughput and the CPU time spent here every few copies
+	void report(int every = 120);
+
+	GpuTimer timer = GpuTimer("Height readback");
+
+private:
+	struct Slot
+	{
+		GLuint buffer = 0;
+		GLsync fence = nullptr;
+		int frame = 0;
+		float time = 0.0f;
+		std::chrono::high_resolution_clock::time_point issued;
+	};
+
+	void release(Slot& slot);
+
+	Shader* shader = nullptr;
+	GLuint image = 0;
+	int resolution = 0;
+
+	std::vector<Slot> ring;
+	int head = 0;
+	int frame = 0;
+
+	std::vector<float> latest;
+	int latestResolution = 0;
+	float latestTime = 0.0f;
+	int latestFrame = 0;
+
+	//counters since the last report
+	int captures = 0;
+	int copies = 0;
+	int skipped = 0;
+	int latencyFrames = 0;
+	double latencyMs = 0.0;
+	double cpuMs = 0.0;
+	size_t bytes = 0;
+	std::chrono::high_resolution_clock::time_point reportStart = std::chrono::high_resolution_clock::now();
+};
@@ -0,0 +1,217 @@
+#include "HeightmapStream.h"
+
+#include <opencv2\opencv.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	long long wrap(long long value, long long size)
+	{
+		long long result = value % size;
+		return (result < 0) ? result + size : result;
+	}
+}
+
+UnpackBuffer::UnpackBuffer(size_t size)
+{
+	if (glBufferStorage)
+	{
+		//written by the decoders while the GL thread keeps drawing, coherent so no flush is needed
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &this->pbo);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->pbo);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+		this->mapping = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	this->base = this->mapping;
+	if (!this->base)
+	{
+		this->staging.resize(size);
+		this->base = this->staging.data();
+	}
+}
+
+UnpackBuffer::~UnpackBuffer()
+{
+	if (this->pbo)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->pbo);
+		if (this->mapping)
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &this->pbo);
+	}
+}
+
+GLsync UnpackBuffer::upload(Texture3D* texture, int slice, const unsigned char* pixels)
+{
+	if (!this->mapping)
+	{
+		//a plain upload copies the pixels before it returns
+		texture->updateSlice(slice, pixels);
+		return 0;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->pbo);
+	texture->updateSlice(slice, (const void*)(pixels - this->mapping));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+HeightmapStream::HeightmapStream(const std::vector<std::string>& paths, int window, int buffers) :
+	paths(paths), window(std::max(window, 2)), bufferCount(std::max(buffers, 1))
+{
+	//the only decode on the GL thread, it decides the size of everything else
+	cv::Mat first;
+	if (!this->paths.empty())
+		first = cv::imread(this->paths[0], cv::IMREAD_GRAYSCALE);
+	this->width = std::max(first.cols, 1);
+	this->height = std::max(first.rows, 1);
+	this->frameSize = (size_t)this->width * this->height;
+
+	this->texture = new Texture3D(this->width, this->height, this->window, GL_R8, GL_RED, GL_UNSIGNED_BYTE);
+	this->slotFrame.assign(this->window, -1);
+
+	this->buffers.reset(new Buffer[this->bufferCount]);
+	this->unpack.reset(new UnpackBuffer(this->frameSize * this->bufferCount));
+	for (int i = 0; i < this->bufferCount; i++)
+		this->buffers[i].pixels = this->unpack->data() + i * this->frameSize;
+
+	this->worker.reset(new ThreadPool(1));
+}
+
+HeightmapStream::~HeightmapStream()
+{
+	this->stopping = true;
+	this->worker.reset();
+
+	for (int i = 0; i < this->bufferCount; i++)
+	{
+		if (this->buffers[i].fence)
+			glDeleteSync(this->buffers[i].fence);
+	}
+	this->unpack.reset();
+	delete this->texture;
+}
+
+bool HeightmapStream::isResident(long long frame) const
+{
+	return this->slotFrame[wrap(frame, this->window)] == frame;
+}
+
+bool HeightmapStream::isPending(long long frame) const
+{
+	for (int i = 0; i < this->bufferCount; i++)
+	{
+		if (this->buffers[i].state != FREE && this->buffers[i].frame == frame)
+			return true;
+	}
+	return false;
+}
+
+//worker thread
+void HeightmapStream::decode(Buffer* buffer, const std::string& path)
+{
+	cv::Mat img;
+	if (!this->stopping)
+		img = cv::imread(path, cv::IMREAD_GRAYSCALE);
+	if (img.cols == this->width && img.rows == this->height)
+	{
+		for (int y = 0; y < this->height; y++)
+			memcpy(buffer->pixels + (size_t)y * this->width, img.ptr<unsigned char>(y), this->width);
+	}
+	else
+	{
+		//flat water rather than whatever the buffer held before
+		memset(buffer->pixels, 128, this->frameSize);
+	}
+	buffer->state.store(DECODED, std::memory_order_release);
+}
+
+void HeightmapStream::update(float cursor)
+{
+	if (this->paths.empty())
+		return;
+	long long current = (long long)std::floor(cursor);
+
+	//buffers the GPU is done reading from can be filled again
+	for (int i = 0; i < this->bufferCount; i++)
+	{
+		Buffer& buffer = this->buffers[i];
+		if (buffer.state != UPLOADING)
+			continue;
+		GLenum result = glClientWaitSync(buffer.fence, 0, 0);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+		{
+			glDeleteSync(buffer.fence);
+			buffer.fence = 0;
+			buffer.state = FREE;
+		}
+	}
+
+	//copy finished decodes into their slices, frames the cursor already passed are dropped
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int i = 0; i < this->bufferCount; i++)
+	{
+		Buffer& buffer = this->buffers[i];
+		if (buffer.state.load(std::memory_order_acquire) != DECODED)
+			continue;
+		if (buffer.frame < current || buffer.frame >= current + this->window)
+		{
+			buffer.state = FREE;
+			continue;
+		}
+		int slot = (int)wrap(buffer.frame, this->window);
+		buffer.fence = this->unpack->upload(this->texture, slot, buffer.pixels);
+		buffer.state = buffer.fence ? UPLOADING : FREE;
+		this->slotFrame[slot] = buffer.frame;
+		this->counters.uploads++;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (this->isResident(current) && this->isResident(current + 1))
+		this->counters.hits++;
+	else
+		this->counters.misses++;
+
+	//request the window nearest first, as long as there are buffers to decode into
+	for (long long frame = current; frame < current + this->window; frame++)
+	{
+		if (this->isResident(frame) || this->isPending(frame))
+			continue;
+		Buffer* buffer = nullptr;
+		for (int i = 0; i < this->bufferCount && !buffer; i++)
+		{
+			if (this->buffers[i].state == FREE)
+				buffer = &this->buffers[i];
+		}
+		if (!buffer)
+		{
+			this->counters.stalls++;
+			break;
+		}
+		buffer->frame = frame;
+		buffer->state = DECODING;
+		std::string path = this->paths[wrap(frame, (long long)this->paths.size())];
+		this->worker->enqueue([this, buffer, path]() { this->decode(buffer, path); });
+	}
+	this->updates++;
+}
+
+void HeightmapStream::report(int every)
+{
+	if (this->updates < every)
+		return;
+	std::cout << "Heightmap stream " << this->window << "/" << this->paths.size() << " frames:"
+		<< " hits " << this->counters.hits - this->reported.hits << ","
+		<< " misses " << this->counters.misses - this->reported.misses << ","
+		<< " stalls " << this->counters.stalls - this->reported.stalls << ","
+		<< " uploads " << this->counters.uploads - this->reported.uploads << std::endl;
+	this->reported = this->counters;
+	this->updates = 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <glad/glad.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "RenderUtilities/Texture3D.h"
+#include "Utilities/ThreadPool.h"
+
+//Pixel unpack buffer the decoders write frames into from another thread, persistently
+//mapped so the GL thread only issues the copy into the texture and fences it.
+//Falls back to a plain staging copy when buffer storage is not available
+class UnpackBuffer
+{
+public:
+	UnpackBuffer(size_t size);
+	~UnpackBuffer();
+	UnpackBuffer(const UnpackBuffer&) = delete;
+	UnpackBuffer& operator=(const UnpackBuffer&) = delete;
+
+	unsigned char* data() { return this->base; }
+	//GL thread, copies pixels (inside data()) into the slice, unpack alignment is up to the caller.
+	//The memory may be written again once the returned fence signals, 0 means right away
+	GLsync upload(Texture3D* texture, int slice, const unsigned char* pixels);
+
+private:
+	GLuint pbo = 0;
+	unsigned char* mapping = nullptr;
+	std::vector<unsigned char> staging;
+	unsigned char* base = nullptr;
+};
+
+//Keeps a window of the heightmap sequence on the GPU instead of every frame.
+//Global frame g lives in slice g % window of a 3D texture, so sampling it exactly like the
+//resident stack with window as the frame count blends g and g + 1 across the ring.
+//A worker thread decodes the frames ahead of the cursor straight into persistently mapped
+//pixel unpack buffers, the GL thread only issues glTexSubImage3D from a buffer once it is
+//filled and fences it, so it never waits on a decode or on the driver
+class HeightmapStream
+{
+public:
+	//paths of the whole sequence, all frames must have the size of the first one
+	HeightmapStream(const std::vector<std::string>& paths, int window = 16, int buffers = 4);
+	~HeightmapStream();
+
+	//GL thread, cursor is the frame being shown (time * rate), it is not wrapped
+	void update(float cursor);
+
+	Texture3D* getTexture() { return this->texture; }
+	int getWindow() const { return this->window; }
+	int getFrameCount() const { return (int)this->paths.size(); }
+
+	//every update counts a hit when both frames the shader blends are resident, a miss
+	//otherwise (the slices still hold older frames), and a stall when a frame could not
+	//be requested because every buffer was busy
+	struct Counters
+	{
+		long long hits = 0;
+		long long misses = 0;
+		long long stalls = 0;
+		long long uploads = 0;
+	};
+	const Counters& getCounters() const { return this->counters; }
+	//print the counters every few updates
+	void report(int every = 120);
+
+private:
+	enum State { FREE, DECODING, DECODED, UPLOADING };
+	struct Buffer
+	{
+		std::atomic<int> state{ FREE };
+		long long frame = -1;
+		unsigned char* pixels = nullptr;	//into the unpack buffer
+		GLsync fence = 0;
+	};
+
+	bool isResident(long long frame) const;
+	bool isPending(long long frame) const;
+	void decode(Buffer* buffer, const std::string& path);
+
+	std::vector<std::string> paths;
+	int window;
+	int width = 0;
+	int height = 0;
+	size_t frameSize = 0;
+
+	Texture3D* texture = nullptr;
+	std::vector<long long> slotFrame;	//global frame held by every slice, -1 when empty
+
+	std::unique_ptr<UnpackBuffer> unpack;
+	std::unique_ptr<Buffer[]> buffers;
+	int bufferCount;
+
+	Counters counters;
+	Counters reported;
+	int updates = 0;
+
+	std::atomic<bool> stopping{ false };
+	//last so queued decodes finish before the buffers go away
+	std::unique_ptr<ThreadPool> worker;
+};
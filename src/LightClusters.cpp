@@ -0,0 +1,171 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	//std430 header of the light_clusters block in lights.glsl, the clusters follow it
+	struct GpuClusterHeader
+	{
+		glm::ivec4 grid;
+		glm::vec4 depth;
+	};
+}
+
+LightClusters::LightClusters(int tilesX, int tilesY, int slices) :
+	tilesX(tilesX), tilesY(tilesY), slices(slices)
+{
+	this->clusters.resize(this->getClusterCount());
+}
+
+void LightClusters::assign(const glm::vec3& center, float range, const glm::mat4& projection, int light, std::vector<Entry>& entries)
+{
+	int x0 = 0, x1 = this->tilesX - 1;
+	int y0 = 0, y1 = this->tilesY - 1;
+	int z0 = 0, z1 = this->slices - 1;
+	//view space looks down -z
+	float depthNear = -center.z - range;
+	float depthFar = -center.z + range;
+	if (std::isfinite(range))
+	{
+		if (depthFar < 0.0f || depthNear > this->zFar)
+			return;
+		float scale = this->slices / std::log(this->zFar / this->zNear);
+		z0 = glm::clamp((int)std::floor(std::log(std::max(depthNear, this->zNear) / this->zNear) * scale), 0, this->slices - 1);
+		z1 = glm::clamp((int)std::floor(std::log(std::max(depthFar, this->zNear) / this->zNear) * scale), 0, this->slices - 1);
+
+		//screen bounds of the box around the sphere, a box reaching behind the eye covers the screen
+		if (depthNear > 0.0f)
+		{
+			glm::vec2 low(1.0f), high(-1.0f);
+			for (int i = 0; i < 8; i++)
+			{
+				glm::vec3 corner = center + glm::vec3(i & 1 ? range : -range, i & 2 ? range : -range, i & 4 ? range : -range);
+				glm::vec4 clip = projection * glm::vec4(corner, 1.0f);
+				glm::vec2 ndc = glm::vec2(clip) / clip.w;
+				low = glm::min(low, ndc);
+				high = glm::max(high, ndc);
+			}
+			if (high.x < -1.0f || high.y < -1.0f || low.x > 1.0f || low.y > 1.0f)
+				return;
+			x0 = glm::clamp((int)std::floor((low.x * 0.5f + 0.5f) * this->tilesX), 0, this->tilesX - 1);
+			x1 = glm::clamp((int)std::floor((high.x * 0.5f + 0.5f) * this->tilesX), 0, this->tilesX - 1);
+			y0 = glm::clamp((int)std::floor((low.y * 0.5f + 0.5f) * this->tilesY), 0, this->tilesY - 1);
+			y1 = glm::clamp((int)std::floor((high.y * 0.5f + 0.5f) * this->tilesY), 0, this->tilesY - 1);
+		}
+	}
+	for (int z = z0; z <= z1; z++)
+	{
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int x = x0; x <= x1; x++)
+				entries.push_back({ (z * this->tilesY + y) * this->tilesX + x, light });
+		}
+	}
+}
+
+void LightClusters::sort(std::vector<Entry>& entries, int first)
+{
+	for (glm::ivec4& cluster : this->clusters)
+		cluster[first + 1] = 0;
+	for (const Entry& entry : entries)
+		this->clusters[entry.cluster][first + 1]++;
+	int offset = (int)this->indices.size();
+	for (glm::ivec4& cluster : this->clusters)
+	{
+		cluster[first] = offset;
+		offset += cluster[first + 1];
+		cluster[first + 1] = 0;
+	}
+	this->indices.resize(offset);
+	for (const Entry& entry : entries)
+	{
+		glm::ivec4& cluster = this->clusters[entry.cluster];
+		this->indices[cluster[first] + cluster[first + 1]] = entry.light;
+		cluster[first + 1]++;
+	}
+}
+
+void LightClusters::build(const LightSet& lights, const glm::mat4& view, const glm::mat4& projection)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	this->pointEntries.clear();
+	this->spotEntries.clear();
+	for (size_t i = 0; i < lights.points.size(); i++)
+	{
+		const LightSet::Point& light = lights.points[i];
+		glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+		this->assign(center, lights.range(light), projection, (int)i, this->pointEntries);
+	}
+	//the cone is bounded by the sphere of its range, looser but never misses a cluster
+	for (size_t i = 0; i < lights.spots.size(); i++)
+	{
+		const LightSet::Spot& light = lights.spots[i];
+		glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+		this->assign(center, lights.range(light), projection, (int)i, this->spotEntries);
+	}
+
+	this->indices.clear();
+	this->sort(this->pointEntries, 0);
+	this->sort(this->spotEntries, 2);
+	this->dirty = true;
+
+	this->buildMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	this->builds++;
+	this->lightCount = (int)(lights.points.size() + lights.spots.size());
+	this->averageSum += (double)this->indices.size() / this->clusters.size();
+	for (const glm::ivec4& cluster : this->clusters)
+		this->maxLights = std::max(this->maxLights, cluster.y + cluster.w);
+}
+
+//the buffers only grow, empty lists still get one element so the binding stays valid
+void LightClusters::upload(GLuint& buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr size)
+{
+	if (!buffer)
+		glGenBuffers(1, &buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	if (size > capacity || capacity == 0)
+	{
+		capacity = glm::max(size, (GLsizeiptr)sizeof(glm::vec4));
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, NULL, GL_DYNAMIC_DRAW);
+	}
+	if (size > 0)
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+}
+
+void LightClusters::bind()
+{
+	if (this->dirty)
+	{
+		GpuClusterHeader header;
+		header.grid = glm::ivec4(this->tilesX, this->tilesY, this->slices, 0);
+		header.depth = glm::vec4(this->zNear, this->slices / std::log(this->zFar / this->zNear), this->zFar, 0.0f);
+		this->block.resize(sizeof(header) + this->clusters.size() * sizeof(glm::ivec4));
+		memcpy(this->block.data(), &header, sizeof(header));
+		memcpy(this->block.data() + sizeof(header), this->clusters.data(), this->clusters.size() * sizeof(glm::ivec4));
+		this->upload(this->buffers[0], this->capacities[0], this->block.data(), this->block.size());
+		this->upload(this->buffers[1], this->capacities[1], this->indices.data(), this->indices.size() * sizeof(int));
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		this->dirty = false;
+	}
+	for (int i = 0; i < 2; i++)
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6 + i, this->buffers[i]);
+}
+
+void LightClusters::report(int every)
+{
+	if (this->builds < every)
+		return;
+	std::cout << this->name << ": " << this->lightCount << " lights, "
+		<< this->averageSum / this->builds << " avg / " << this->maxLights << " max per cluster, "
+		<< this->buildMs / this->builds << " ms build" << std::endl;
+	this->builds = 0;
+	this->buildMs = 0.0;
+	this->averageSum = 0.0;
+	this->maxLights = 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "LightSet.h"
+
+//Froxel grid of one camera: tiles uniform in screen space, slices exponential in view depth.
+//Every point and spot light goes to the clusters its range sphere overlaps, so a fragment
+//only loops over the lights of its cluster (lightCluster in lights.glsl) instead of all of them
+class LightClusters
+{
+public:
+	LightClusters(int tilesX = 16, int tilesY = 9, int slices = 24);
+
+	//view and projection of the pass the clusters are for, lights past far are left out
+	void build(const LightSet& lights, const glm::mat4& view, const glm::mat4& projection);
+	//uploads the clusters to shader storage binding 6 and the light indices to 7, the upload
+	//only happens once per build so passes can rebind their clusters
+	void bind();
+
+	//lights culled and average and max lights per cluster since the last report
+	void report(int every = 120);
+
+	int getClusterCount() const { return this->tilesX * this->tilesY * this->slices; }
+	int getIndexCount() const { return (int)this->indices.size(); }
+
+	//view distance of the first slice boundary and of the last
+	float zNear = 1.0f;
+	float zFar = 1000.0f;
+
+	const char* name = "Light clusters";
+
+private:
+	struct Entry
+	{
+		int cluster;
+		int light;
+	};
+
+	//adds the clusters a sphere in view space overlaps, range may be infinite
+	void assign(const glm::vec3& center, float range, const glm::mat4& projection, int light, std::vector<Entry>& entries);
+	//counting sort of entries into indices, offset and count go to components first and first + 1
+	void sort(std::vector<Entry>& entries, int first);
+	void upload(GLuint& buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr size);
+
+	int tilesX;
+	int tilesY;
+	int slices;
+	std::vector<glm::ivec4> clusters;	//point offset, point count, spot offset, spot count
+	std::vector<int> indices;
+	std::vector<Entry> pointEntries;
+	std::vector<Entry> spotEntries;
+	std::vector<unsigned char> block;	//the header and the clusters as bind() uploads them
+	bool dirty = true;
+
+	GLuint buffers[2] = { 0, 0 };
+	GLsizeiptr capacities[2] = { 0, 0 };
+
+	int builds = 0;
+	double buildMs = 0.0;
+	double averageSum = 0.0;
+	int maxLights = 0;
+	int lightCount = 0;
+};
@@ -0,0 +1,127 @@
+#include "LightSet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+	//std140 layout of the light_set block in lights.glsl
+	struct GpuDirectional
+	{
+		glm::vec4 direction;
+		glm::vec4 ambient;
+		glm::vec4 diffuse;
+		glm::vec4 specular;
+	};
+	struct GpuLightBlock
+	{
+		glm::ivec4 counts;
+		GpuDirectional directional[LightSet::MAX_DIRECTIONAL];
+	};
+	static_assert(sizeof(GpuLightBlock) == 16 + LightSet::MAX_DIRECTIONAL * 64, "light_set must match std140");
+
+	float brightest(const glm::vec3& color)
+	{
+		return std::max(color.x, std::max(color.y, color.z));
+	}
+}
+
+float LightSet::range(const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular,
+	float constant, float linear, float quadratic) const
+{
+	//1 / (c + l d + q d^2) * brightness = threshold
+	float brightness = brightest(ambient) + brightest(diffuse) + brightest(specular);
+	float limit = brightness / this->threshold - constant;
+	if (limit <= 0.0f)
+		return 0.0f;
+	if (quadratic > 0.0f)
+		return (-linear + std::sqrt(linear * linear + 4.0f * quadratic * limit)) / (2.0f * quadratic);
+	if (linear > 0.0f)
+		return limit / linear;
+	return std::numeric_limits<float>::infinity();
+}
+
+float LightSet::range(const Point& light) const
+{
+	return this->range(light.ambient, light.diffuse, light.specular, light.constant, light.linear, light.quadratic);
+}
+
+float LightSet::range(const Spot& light) const
+{
+	return this->range(light.ambient, light.diffuse, light.specular, light.constant, light.linear, light.quadratic);
+}
+
+//the buffers only grow, empty lists still get one element so the binding stays valid
+void LightSet::upload(Buffer& buffer, GLenum target, const void* data, size_t size)
+{
+	if (!buffer.buffer)
+		glGenBuffers(1, &buffer.buffer);
+	//the lights that follow the camera are set every frame, most frames nothing moved
+	if (buffer.uploaded.size() == size && buffer.capacity > 0 && memcmp(buffer.uploaded.data(), data, size) == 0)
+		return;
+	glBindBuffer(target, buffer.buffer);
+	if ((GLsizeiptr)size > buffer.capacity || buffer.capacity == 0)
+	{
+		buffer.capacity = std::max((GLsizeiptr)size, (GLsizeiptr)sizeof(glm::vec4));
+		glBufferData(target, buffer.capacity, NULL, GL_DYNAMIC_DRAW);
+	}
+	if (size > 0)
+		glBufferSubData(target, 0, size, data);
+	glBindBuffer(target, 0);
+	buffer.uploaded.assign((const unsigned char*)data, (const unsigned char*)data + size);
+}
+
+void LightSet::bind()
+{
+	GpuLightBlock block{};
+	int directionalCount = std::min((int)this->directional.size(), MAX_DIRECTIONAL);
+	block.counts = glm::ivec4(directionalCount, (int)this->points.size(), (int)this->spots.size(), 0);
+	for (int i = 0; i < directionalCount; i++)
+	{
+		const Directional& light = this->directional[i];
+		block.directional[i].direction = glm::vec4(light.direction, 0.0f);
+		block.directional[i].ambient = glm::vec4(light.ambient, 0.0f);
+		block.directional[i].diffuse = glm::vec4(light.diffuse, 0.0f);
+		block.directional[i].specular = glm::vec4(light.specular, 0.0f);
+	}
+
+	//packed into the same vectors every frame, they only grow
+	this->gpuPoints.resize(this->points.size());
+	for (size_t i = 0; i < this->gpuPoints.size(); i++)
+	{
+		const Point& light = this->points[i];
+		GpuPoint& gpu = this->gpuPoints[i];
+		gpu.position = light.position;
+		gpu.constant = light.constant;
+		gpu.ambient = light.ambient;
+		gpu.linear = light.linear;
+		gpu.diffuse = light.diffuse;
+		gpu.quadratic = light.quadratic;
+		gpu.specular = glm::vec4(light.specular, 0.0f);
+	}
+	this->gpuSpots.resize(this->spots.size());
+	for (size_t i = 0; i < this->gpuSpots.size(); i++)
+	{
+		const Spot& light = this->spots[i];
+		GpuSpot& gpu = this->gpuSpots[i];
+		gpu.position = light.position;
+		gpu.constant = light.constant;
+		gpu.ambient = light.ambient;
+		gpu.linear = light.linear;
+		gpu.diffuse = light.diffuse;
+		gpu.quadratic = light.quadratic;
+		gpu.specular = light.specular;
+		gpu.cutoff = glm::cos(glm::radians(light.cutoff));
+		gpu.direction = light.direction;
+		gpu.outerCutoff = glm::cos(glm::radians(light.outerCutoff));
+	}
+
+	this->upload(this->block, GL_UNIFORM_BUFFER, &block, sizeof(block));
+	this->upload(this->pointBuffer, GL_SHADER_STORAGE_BUFFER, this->gpuPoints.data(), this->gpuPoints.size() * sizeof(GpuPoint));
+	this->upload(this->spotBuffer, GL_SHADER_STORAGE_BUFFER, this->gpuSpots.data(), this->gpuSpots.size() * sizeof(GpuSpot));
+	glBindBufferBase(GL_UNIFORM_BUFFER, 2, this->block.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, this->pointBuffer.buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, this->spotBuffer.buffer);
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+//Every light of the scene, shared by all lit programs. The directional lights and how many
+//lights of each kind there are go to a std140 uniform block (binding 2), point and spot
+//lights to shader storage bindings 4 and 5 so there can be any number of them. bind()
+//uploads once a frame and only what changed, LightClusters picks the ones a fragment loops over
+class LightSet
+{
+public:
+	static const int MAX_DIRECTIONAL = 4;
+
+	struct Directional
+	{
+		glm::vec3 direction = glm::vec3(0, -1, 0);
+		glm::vec3 ambient = glm::vec3(0.2f);
+		glm::vec3 diffuse = glm::vec3(1.0f);
+		glm::vec3 specular = glm::vec3(1.0f);
+	};
+	struct Point
+	{
+		glm::vec3 position;
+		glm::vec3 ambient = glm::vec3(0.2f);
+		glm::vec3 diffuse = glm::vec3(1.0f);
+		glm::vec3 specular = glm::vec3(1.0f);
+		float constant = 1.0f;
+		float linear = 0.0f;
+		float quadratic = 0.0f;
+	};
+	struct Spot
+	{
+		glm::vec3 position;
+		glm::vec3 direction = glm::vec3(0, -1, 0);
+		glm::vec3 ambient = glm::vec3(0.2f);
+		glm::vec3 diffuse = glm::vec3(1.0f);
+		glm::vec3 specular = glm::vec3(1.0f);
+		float constant = 1.0f;
+		float linear = 0.0f;
+		float quadratic = 0.0f;
+		float cutoff = 10.0f;		//degrees, full intensity inside
+		float outerCutoff = 15.0f;	//degrees, dark outside
+	};
+
+	//directional lights past MAX_DIRECTIONAL are left out
+	std::vector<Directional> directional;
+	std::vector<Point> points;
+	std::vector<Spot> spots;
+
+	//distance at which a light's attenuation drops below threshold of its brightest colour,
+	//infinite for lights that do not fall off
+	float range(const Point& light) const;
+	float range(const Spot& light) const;
+
+	//packs the lights, uploads whatever differs from the last upload and binds the buffers,
+	//needs a current GL context
+	void bind();
+
+	//fraction of full intensity below which a light is treated as out of reach
+	float threshold = 1.0f / 256.0f;
+
+private:
+	//std430 elements of point_lights and spot_lights
+	struct GpuPoint
+	{
+		glm::vec3 position;
+		float constant;
+		glm::vec3 ambient;
+		float linear;
+		glm::vec3 diffuse;
+		float quadratic;
+		glm::vec4 specular;
+	};
+	struct GpuSpot
+	{
+		glm::vec3 position;
+		float constant;
+		glm::vec3 ambient;
+		float linear;
+		glm::vec3 diffuse;
+		float quadratic;
+		glm::vec3 specular;
+		float cutoff;
+		glm::vec3 direction;
+		float outerCutoff;
+	};
+	static_assert(sizeof(GpuPoint) == 64 && sizeof(GpuSpot) == 80, "light storage must match std430");
+	struct Buffer
+	{
+		GLuint buffer = 0;
+		GLsizeiptr capacity = 0;
+		std::vector<unsigned char> uploaded;
+	};
+
+	float range(const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular,
+		float constant, float linear, float quadratic) const;
+	void upload(Buffer& buffer, GLenum target, const void* data, size_t size);
+
+	Buffer block;
+	Buffer pointBuffer;
+	Buffer spotBuffer;
+	std::vector<GpuPoint> gpuPoints;
+	std::vector<GpuSpot> gpuSpots;
+};
@@ -6,7 +6,7 @@ void aBox::draw(Shader* shader, glm::mat4 model)
 	{
 		this->generateVAO();
 	}
-	glUniformMatrix4fv(glGetUniformLocation(shader->Program, "u_model"), 1, GL_FALSE, &model[0][0]);
+	shader->setModel(model);
 	glBindVertexArray(this->vao->vao);
 
 	glDrawElements(GL_TRIANGLES, this->vao->element_amount, GL_UNSIGNED_INT, 0);
@@ -203,7 +203,7 @@ void mySphere::draw(Shader * shader, glm::mat4 model)
 	{
 		this->generateVAO();
 	}
-	glUniformMatrix4fv(glGetUniformLocation(shader->Program, "u_model"), 1, GL_FALSE, &model[0][0]);
+	shader->setModel(model);
 	glBindVertexArray(this->vao->vao);
 
 	glDrawElements(GL_TRIANGLES, this->vao->element_amount, GL_UNSIGNED_INT, 0);
@@ -267,7 +267,7 @@ void aPlane::draw(Shader * shader, glm::mat4 model)
 	{
 		this->generateVAO();
 	}
-	glUniformMatrix4fv(glGetUniformLocation(shader->Program, "u_model"), 1, GL_FALSE, &model[0][0]);
+	shader->setModel(model);
 	glBindVertexArray(this->vao->vao);
 
 	glDrawElements(GL_TRIANGLES, this->vao->element_amount, GL_UNSIGNED_INT, 0);
@@ -353,7 +353,7 @@ void aSurface::draw(Shader * shader, glm::mat4 model)
 	{
 		this->generateVAO();
 	}
-	glUniformMatrix4fv(glGetUniformLocation(shader->Program, "u_model"), 1, GL_FALSE, &model[0][0]);
+	shader->setModel(model);
 	glBindVertexArray(this->vao->vao);
 	glPatchParameteri(GL_PATCH_VERTICES, 3);
 	glDrawElements(GL_PATCHES, this->vao->element_amount, GL_UNSIGNED_INT, 0);
@@ -510,7 +510,7 @@ void aBgPlane::draw(Shader * shader, glm::mat4 model)
 	{
 		this->generateVAO();
 	}
-	glUniformMatrix4fv(glGetUniformLocation(shader->Program, "u_model"), 1, GL_FALSE, &model[0][0]);
+	shader->setModel(model);
 	glBindVertexArray(this->vao->vao);
 
 	glDrawElements(GL_QUADS, this->vao->element_amount, GL_UNSIGNED_INT, 0);
@@ -0,0 +1,299 @@
+#include "OceanFFT.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+namespace
+{
+	const float GRAVITY = 9.81f;
+	const float PI = 3.14159265358979f;
+	//columns are gathered in blocks of this many so every row access touches whole cache lines
+	const int COLUMN_BLOCK = 8;
+
+	double elapsedMs(std::chrono::high_resolution_clock::time_point since)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - since).count();
+	}
+}
+
+bool OceanFFT::Settings::operator==(const Settings& other) const
+{
+	return this->resolution == other.resolution && this->patchSize == other.patchSize &&
+		this->windSpeed == other.windSpeed && this->windDirection == other.windDirection &&
+		this->spectrum == other.spectrum && this->fetch == other.fetch &&
+		this->peakEnhancement == other.peakEnhancement && this->repeatPeriod == other.repeatPeriod &&
+		this->seed == other.seed;
+}
+
+OceanFFT::OceanFFT(const Settings& settings, ThreadPool* pool) :
+	settings(settings), pool(pool)
+{
+	this->generateSpectrum();
+}
+
+void OceanFFT::setSettings(const Settings& settings)
+{
+	if (settings == this->settings)
+		return;
+	this->settings = settings;
+	this->generateSpectrum();
+}
+
+float OceanFFT::spectrumAt(const glm::vec2& k) const
+{
+	float kLength = glm::length(k);
+	if (kLength < 1e-6f)
+		return 0.0f;
+	glm::vec2 wind = glm::normalize(this->settings.windDirection);
+	float cosTheta = glm::dot(k / kLength, wind);
+	float windSpeed = glm::max(this->settings.windSpeed, 0.1f);
+
+	if (this->settings.spectrum == PHILLIPS)
+	{
+		float L = windSpeed * windSpeed / GRAVITY;
+		float l = L / 1000.0f;
+		float k2 = kLength * kLength;
+		return std::exp(-1.0f / (k2 * L * L)) / (k2 * k2) * cosTheta * cosTheta * std::exp(-k2 * l * l);
+	}
+
+	//JONSWAP frequency spectrum turned into a wave number spectrum with cos^2 spreading
+	float fetch = glm::max(this->settings.fetch, 1.0f);
+	float w = std::sqrt(GRAVITY * kLength);
+	float alpha = 0.076f * std::pow(windSpeed * windSpeed / (fetch * GRAVITY), 0.22f);
+	float peak = 22.0f * std::pow(GRAVITY * GRAVITY / (windSpeed * fetch), 1.0f / 3.0f);
+	float sigma = (w <= peak) ? 0.07f : 0.09f;
+	float r = std::exp(-(w - peak) * (w - peak) / (2.0f * sigma * sigma * peak * peak));
+	float S = alpha * GRAVITY * GRAVITY / std::pow(w, 5.0f) * std::exp(-1.25f * std::pow(peak / w, 4.0f)) *
+		std::pow(this->settings.peakEnhancement, r);
+	float dwdk = GRAVITY / (2.0f * w);
+	float spreading = (cosTheta > 0.0f) ? 2.0f / PI * cosTheta * cosTheta : 0.0f;
+	return S * dwdk / kLength * spreading;
+}
+
+void OceanFFT::generateSpectrum()
+{
+	const int n = this->settings.resolution;
+	this->h0.assign(n * n * 2, 0.0f);
+	this->omega.assign(n * n, 0.0f);
+	this->heightSlopeX.assign(n * n * 2, 0.0f);
+	this->slopeZ.assign(n * n * 2, 0.0f);
+	this->heightSlope.assign(n * n * 4, 0.0f);
+
+	int bits = 0;
+	while ((1 << bits) < n)
+		bits++;
+	this->bitReverse.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		int r = 0;
+		for (int b = 0; b < bits; b++)
+			r |= ((i >> b) & 1) << (bits - 1 - b);
+		this->bitReverse[i] = r;
+	}
+	//inverse transform, so the twiddles rotate counter clockwise
+	this->twiddle.resize(n);
+	for (int i = 0; i < n / 2; i++)
+	{
+		this->twiddle[i * 2] = std::cos(2.0f * PI * i / n);
+		this->twiddle[i * 2 + 1] = std::sin(2.0f * PI * i / n);
+	}
+
+	std::mt19937 random(this->settings.seed);
+	std::normal_distribution<float> gaussian(0.0f, 1.0f);
+	float dk = 2.0f * PI / this->settings.patchSize;
+	float baseOmega = (this->settings.repeatPeriod > 0.0f) ? 2.0f * PI / this->settings.repeatPeriod : 0.0f;
+	double variance = 0.0;
+	for (int y = 0; y < n; y++)
+	{
+		for (int x = 0; x < n; x++)
+		{
+			int kx = (x < n / 2) ? x : x - n;
+			int ky = (y < n / 2) ? y : y - n;
+			float re = gaussian(random);
+			float im = gaussian(random);
+			//the nyquist row and column have no conjugate partner, leave them empty
+			if (kx == -n / 2 || ky == -n / 2)
+				continue;
+			glm::vec2 k(kx * dk, ky * dk);
+			float amplitude = std::sqrt(this->spectrumAt(k) * dk * dk * 0.5f);
+			this->h0[(y * n + x) * 2] = re * amplitude;
+			this->h0[(y * n + x) * 2 + 1] = im * amplitude;
+			variance += 2.0 * amplitude * amplitude * (re * re + im * im);
+
+			float w = std::sqrt(GRAVITY * glm::length(k));
+			if (baseOmega > 0.0f)
+				w = std::floor(w / baseOmega) * baseOmega;
+			this->omega[y * n + x] = w;
+		}
+	}
+	this->heightScale = (variance > 0.0) ? (float)(1.0 / (3.0 * std::sqrt(variance))) : 1.0f;
+}
+
+//in place iterative radix-2 transform of one contiguous row of complex values
+void OceanFFT::inverseFFT(float* data) const
+{
+	const int n = this->settings.resolution;
+	for (int i = 0; i < n; i++)
+	{
+		int j = this->bitReverse[i];
+		if (j > i)
+		{
+			std::swap(data[i * 2], data[j * 2]);
+			std::swap(data[i * 2 + 1], data[j * 2 + 1]);
+		}
+	}
+	for (int size = 2; size <= n; size <<= 1)
+	{
+		int half = size >> 1;
+		int stride = n / size;
+		for (int start = 0; start < n; start += size)
+		{
+			for (int k = 0; k < half; k++)
+			{
+				float wr = this->twiddle[k * stride * 2];
+				float wi = this->twiddle[k * stride * 2 + 1];
+				float* a = data + (start + k) * 2;
+				float* b = data + (start + k + half) * 2;
+				float tr = b[0] * wr - b[1] * wi;
+				float ti = b[0] * wi + b[1] * wr;
+				b[0] = a[0] - tr;
+				b[1] = a[1] - ti;
+				a[0] += tr;
+				a[1] += ti;
+			}
+		}
+	}
+}
+
+void OceanFFT::columnsFFT(int blockBegin, int blockEnd)
+{
+	const int n = this->settings.resolution;
+	std::vector<float> scratch(COLUMN_BLOCK * n * 2);
+	float* targets[2] = { this->heightSlopeX.data(), this->slopeZ.data() };
+	for (float* target : targets)
+	{
+		for (int block = blockBegin; block < blockEnd; block++)
+		{
+			int column = block * COLUMN_BLOCK;
+			for (int y = 0; y < n; y++)
+			{
+				const float* row = target + (y * n + column) * 2;
+				for (int c = 0; c < COLUMN_BLOCK; c++)
+				{
+					scratch[(c * n + y) * 2] = row[c * 2];
+					scratch[(c * n + y) * 2 + 1] = row[c * 2 + 1];
+				}
+			}
+			for (int c = 0; c < COLUMN_BLOCK; c++)
+				this->inverseFFT(scratch.data() + c * n * 2);
+			for (int y = 0; y < n; y++)
+			{
+				float* row = target + (y * n + column) * 2;
+				for (int c = 0; c < COLUMN_BLOCK; c++)
+				{
+					row[c * 2] = scratch[(c * n + y) * 2];
+					row[c * 2 + 1] = scratch[(c * n + y) * 2 + 1];
+				}
+			}
+		}
+	}
+}
+
+void OceanFFT::update(float time)
+{
+	const int n = this->settings.resolution;
+	const float dk = 2.0f * PI / this->settings.patchSize;
+
+	//h(k, t) = h0(k) e^(iwt) + conj(h0(-k)) e^(-iwt)
+	//height and x slope are real fields, so they share one transform as h + i * sx
+	auto start = std::chrono::high_resolution_clock::now();
+	this->parallelFor(0, n, [this, n, dk, time](int rowBegin, int rowEnd)
+	{
+		for (int y = rowBegin; y < rowEnd; y++)
+		{
+			int ky = (y < n / 2) ? y : y - n;
+			int my = (n - y) % n;
+			for (int x = 0; x < n; x++)
+			{
+				int kx = (x < n / 2) ? x : x - n;
+				int mx = (n - x) % n;
+				int idx = y * n + x;
+				int minus = my * n + mx;
+				float c = std::cos(this->omega[idx] * time);
+				float s = std::sin(this->omega[idx] * time);
+				float ar = this->h0[idx * 2], ai = this->h0[idx * 2 + 1];
+				float br = this->h0[minus * 2], bi = -this->h0[minus * 2 + 1];
+				float hr = (ar * c - ai * s) + (br * c + bi * s);
+				float hi = (ar * s + ai * c) + (bi * c - br * s);
+
+				//(1 - kx) * h is h + i * (i * kx * h)
+				float fx = kx * dk, fy = ky * dk;
+				this->heightSlopeX[idx * 2] = hr - fx * hr;
+				this->heightSlopeX[idx * 2 + 1] = hi - fx * hi;
+				//i * ky * h
+				this->slopeZ[idx * 2] = -fy * hi;
+				this->slopeZ[idx * 2 + 1] = fy * hr;
+			}
+		}
+	});
+	this->timings.spectrum = elapsedMs(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	this->parallelFor(0, n, [this, n](int rowBegin, int rowEnd)
+	{
+		for (int y = rowBegin; y < rowEnd; y++)
+		{
+			this->inverseFFT(this->heightSlopeX.data() + y * n * 2);
+			this->inverseFFT(this->slopeZ.data() + y * n * 2);
+		}
+	});
+	this->timings.rows = elapsedMs(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	this->parallelFor(0, n / COLUMN_BLOCK, [this](int blockBegin, int blockEnd) { this->columnsFFT(blockBegin, blockEnd); });
+	this->timings.columns = elapsedMs(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	//slopes go from per meter to per tile
+	const float slopeScale = this->heightScale * this->settings.patchSize;
+	this->parallelFor(0, n, [this, n, slopeScale](int rowBegin, int rowEnd)
+	{
+		for (int i = rowBegin * n; i < rowEnd * n; i++)
+		{
+			this->heightSlope[i * 4] = this->heightSlopeX[i * 2 + 1] * slopeScale;
+			this->heightSlope[i * 4 + 1] = this->slopeZ[i * 2] * slopeScale;
+			this->heightSlope[i * 4 + 2] = this->heightSlopeX[i * 2] * this->heightScale;
+			this->heightSlope[i * 4 + 3] = 0.0f;
+		}
+	});
+	this->timings.pack = elapsedMs(start);
+
+	this->total.spectrum += this->timings.spectrum;
+	this->total.rows += this->timings.rows;
+	this->total.columns += this->timings.columns;
+	this->total.pack += this->timings.pack;
+	this->samples++;
+}
+
+void OceanFFT::parallelFor(int begin, int end, const std::function<void(int, int)>& body)
+{
+	if (this->pool)
+		this->pool->parallelFor(begin, end, body);
+	else
+		body(begin, end);
+}
+
+void OceanFFT::report(int every)
+{
+	if (this->samples < every)
+		return;
+	std::cout << "Ocean " << this->settings.resolution << "^2:"
+		<< " spectrum " << this->total.spectrum / this->samples << " ms,"
+		<< " rows " << this->total.rows / this->samples << " ms,"
+		<< " columns " << this->total.columns / this->samples << " ms,"
+		<< " pack " << this->total.pack / this->samples << " ms" << std::endl;
+	this->total = Timings();
+	this->samples = 0;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Utilities/ThreadPool.h"
+
+//Tessendorf style ocean: a Phillips or JONSWAP spectrum is animated in frequency
+//space and brought back with a radix-2 2D inverse FFT split over the thread pool.
+//The result is a tileable RGBA float image (dh/du, dh/dv, h, 0) per patch texel,
+//heights are normalized so that +-3 standard deviations map to +-1
+class OceanFFT
+{
+public:
+	enum Spectrum { PHILLIPS, JONSWAP };
+
+	struct Settings
+	{
+		int resolution = 256;			//power of two, 128 - 1024
+		float patchSize = 200.0f;		//meters covered by one tile
+		float windSpeed = 20.0f;		//m/s
+		glm::vec2 windDirection = glm::vec2(1.0f, -1.0f);
+		Spectrum spectrum = PHILLIPS;
+		float fetch = 100000.0f;		//meters, JONSWAP only
+		float peakEnhancement = 3.3f;	//gamma, JONSWAP only
+		float repeatPeriod = 0.0f;		//seconds, > 0 quantizes the frequencies so the animation loops
+		unsigned int seed = 1;
+
+		bool operator==(const Settings& other) const;
+		bool operator!=(const Settings& other) const { return !(*this == other); }
+	};
+
+	//milliseconds spent in each stage of the last update
+	struct Timings
+	{
+		double spectrum = 0.0;
+		double rows = 0.0;
+		double columns = 0.0;
+		double pack = 0.0;
+	};
+
+	//without a pool every update runs on the calling thread, for callers that
+	//keep one instance per thread themselves
+	OceanFFT(const Settings& settings, ThreadPool* pool = &ThreadPool::shared());
+
+	void setSettings(const Settings& settings);
+	const Settings& getSettings() const { return this->settings; }
+
+	void update(float time);
+	const float* getHeightSlope() const { return this->heightSlope.data(); }
+	int getResolution() const { return this->settings.resolution; }
+
+	//print the average stage timings every few updates
+	void report(int every = 120);
+
+	Timings timings;
+
+private:
+	void generateSpectrum();
+	float spectrumAt(const glm::vec2& k) const;
+	void inverseFFT(float* data) const;
+	void columnsFFT(int columnBegin, int columnEnd);
+	void parallelFor(int begin, int end, const std::function<void(int, int)>& body);
+
+	Settings settings;
+	ThreadPool* pool;
+
+	//complex values are interleaved (re, im)
+	std::vector<float> h0;
+	std::vector<float> omega;
+	std::vector<float> heightSlopeX;
+	std::vector<float> slopeZ;
+	std::vector<float> heightSlope;
+	std::vector<int> bitReverse;
+	std::vector<float> twiddle;
+	float heightScale = 1.0f;
+
+	Timings total;
+	int samples = 0;
+};
@@ -0,0 +1,200 @@
+#include "Picker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	//marching steps through the wave slab and bisection steps once the surface is bracketed
+	const int MARCH_STEPS = 32;
+	const int BISECT_STEPS = 12;
+
+	//slab test, returns the entry distance and the face normal
+	bool intersect(const Picker::Ray& ray, const glm::vec3& low, const glm::vec3& high, float& distance, glm::vec3& normal)
+	{
+		float nearest = 0.0f;
+		float farthest = std::numeric_limits<float>::max();
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (ray.direction[axis] == 0.0f)
+			{
+				if (ray.origin[axis] < low[axis] || ray.origin[axis] > high[axis])
+					return false;
+				continue;
+			}
+			float inverse = 1.0f / ray.direction[axis];
+			float t0 = (low[axis] - ray.origin[axis]) * inverse;
+			float t1 = (high[axis] - ray.origin[axis]) * inverse;
+			glm::vec3 face;
+			face[axis] = inverse < 0.0f ? 1.0f : -1.0f;
+			if (t0 > t1)
+				std::swap(t0, t1);
+			if (t0 > nearest)
+			{
+				nearest = t0;
+				normal = face;
+			}
+			farthest = std::min(farthest, t1);
+			if (nearest > farthest)
+				return false;
+		}
+		distance = nearest;
+		return true;
+	}
+
+	bool intersect(const Picker::Ray& ray, const glm::vec3& center, float radius, float& distance)
+	{
+		glm::vec3 offset = ray.origin - center;
+		float b = glm::dot(offset, ray.direction);
+		float c = glm::dot(offset, offset) - radius * radius;
+		float discriminant = b * b - c;
+		if (discriminant < 0.0f)
+			return false;
+		float root = std::sqrt(discriminant);
+		distance = -b - root >= 0.0f ? -b - root : -b + root;
+		return distance >= 0.0f;
+	}
+}
+
+Picker::Ray Picker::mouseRay(const glm::mat4& view, const glm::mat4& projection, float x, float y, int width, int height)
+{
+	glm::vec4 viewport(0, 0, width, height);
+	glm::vec3 nearPoint = glm::unProject(glm::vec3(x, height - y, 0.0f), view, projection, viewport);
+	glm::vec3 farPoint = glm::unProject(glm::vec3(x, height - y, 1.0f), view, projection, viewport);
+	Ray ray;
+	ray.origin = nearPoint;
+	ray.direction = glm::normalize(farPoint - nearPoint);
+	return ray;
+}
+
+glm::vec2 Picker::waterUV(const glm::vec3& position) const
+{
+	return glm::vec2(position.x / (2.0f * this->halfSize) + 0.5f, 0.5f - position.z / (2.0f * this->halfSize));
+}
+
+float Picker::castWater(const Ray& ray) const
+{
+	if (ray.direction.y == 0.0f)
+		return -1.0f;
+	float plane = (this->waterLevel - ray.origin.y) / ray.direction.y;
+	if (!this->waterHeight || this->waveBound <= 0.0f)
+		return plane;
+
+	//walk the part of the ray inside the slab the waves move in, then bisect the crossing
+	float t0 = (this->waterLevel + this->waveBound - ray.origin.y) / ray.direction.y;
+	float t1 = (this->waterLevel - this->waveBound - ray.origin.y) / ray.direction.y;
+	if (t0 > t1)
+		std::swap(t0, t1);
+	t0 = std::max(t0, 0.0f);
+	if (t1 < t0)
+		return -1.0f;
+	auto above = [&](float t)
+	{
+		glm::vec3 p = ray.origin + ray.direction * t;
+		return p.y - this->waterLevel - this->waterHeight(glm::vec2(p.x, p.z));
+	};
+	float previous = t0;
+	float previousAbove = above(t0);
+	for (int i = 1; i <= MARCH_STEPS; i++)
+	{
+		float t = t0 + (t1 - t0) * i / MARCH_STEPS;
+		float current = above(t);
+		if ((previousAbove > 0.0f) != (current > 0.0f))
+		{
+			float low = previous, high = t;
+			for (int j = 0; j < BISECT_STEPS; j++)
+			{
+				float middle = 0.5f * (low + high);
+				if ((above(middle) > 0.0f) == (previousAbove > 0.0f))
+					low = middle;
+				else
+					high = middle;
+			}
+			return 0.5f * (low + high);
+		}
+		previous = t;
+		previousAbove = current;
+	}
+	//grazing rays can skip a crest, fall back to the plane
+	return plane;
+}
+
+Picker::Hit Picker::cast(const Ray& ray) const
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	Hit hit;
+	hit.distance = std::numeric_limits<float>::max();
+	auto closer = [&](Kind kind, float distance, const glm::vec3& normal, int object)
+	{
+		if (distance < 0.0f || distance >= hit.distance)
+			return;
+		hit.kind = kind;
+		hit.distance = distance;
+		hit.normal = normal;
+		hit.object = object;
+	};
+	auto inside = [&](const glm::vec3& p)
+	{
+		const float slack = 0.001f;
+		return std::abs(p.x) <= this->halfSize + slack && std::abs(p.z) <= this->halfSize + slack
+			&& p.y >= this->floor - slack && p.y <= this->top + slack;
+	};
+
+	float water = this->castWater(ray);
+	if (water >= 0.0f && inside(ray.origin + ray.direction * water))
+		closer(Water, water, glm::vec3(0, 1, 0), -1);
+
+	//the four walls and the floor, only within the pool
+	struct { int axis; float level; } walls[5] = {
+		{ 0, -this->halfSize }, { 0, this->halfSize }, { 2, -this->halfSize }, { 2, this->halfSize }, { 1, this->floor } };
+	for (const auto& wall : walls)
+	{
+		if (ray.direction[wall.axis] == 0.0f)
+			continue;
+		float t = (wall.level - ray.origin[wall.axis]) / ray.direction[wall.axis];
+		if (t < 0.0f || !inside(ray.origin + ray.direction * t))
+			continue;
+		glm::vec3 normal;
+		normal[wall.axis] = ray.direction[wall.axis] < 0.0f ? 1.0f : -1.0f;
+		closer(Wall, t, normal, -1);
+	}
+
+	for (size_t i = 0; i < this->boxes.size(); i++)
+	{
+		float t;
+		glm::vec3 normal;
+		if (intersect(ray, this->boxes[i].low, this->boxes[i].high, t, normal))
+			closer(Box, t, normal, (int)i);
+	}
+	for (size_t i = 0; i < this->spheres.size(); i++)
+	{
+		float t;
+		if (intersect(ray, this->spheres[i].center, this->spheres[i].radius, t))
+			closer(Sphere, t, glm::normalize(ray.origin + ray.direction * t - this->spheres[i].center), (int)i);
+	}
+
+	if (hit.kind == None)
+		hit.distance = 0.0f;
+	else
+	{
+		hit.position = ray.origin + ray.direction * hit.distance;
+		hit.uv = this->waterUV(hit.position);
+	}
+
+	this->pickUs += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	this->picks++;
+	return hit;
+}
+
+void Picker::report(int every)
+{
+	if (this->picks < every)
+		return;
+	std::cout << "Picker: " << this->picks << " picks, " << this->pickUs / this->picks << " us each" << std::endl;
+	this->picks = 0;
+	this->pickUs = 0.0;
+}
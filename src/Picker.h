@@ -0,0 +1,76 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <functional>
+#include <vector>
+
+//Casts the mouse ray on the CPU against what the scene is made of: the water plane, the
+//pool walls and floor and the bounding volumes of the objects. A pick is a handful of
+//ray-shape tests, so it costs microseconds and never waits on the GPU
+class Picker
+{
+public:
+	struct Ray
+	{
+		glm::vec3 origin;
+		glm::vec3 direction;	//unit length
+	};
+
+	enum Kind { None, Water, Wall, Box, Sphere };
+
+	struct Hit
+	{
+		Kind kind = None;
+		float distance = 0.0f;
+		glm::vec3 position;
+		glm::vec3 normal;
+		//texture coordinate of the surface, for water hits
+		glm::vec2 uv;
+		//index into boxes or spheres
+		int object = -1;
+	};
+
+	struct BoxBounds
+	{
+		glm::vec3 low;
+		glm::vec3 high;
+	};
+	struct SphereBounds
+	{
+		glm::vec3 center;
+		float radius;
+	};
+
+	//ray through a window position, y going down as in FlTk
+	static Ray mouseRay(const glm::mat4& view, const glm::mat4& projection, float x, float y, int width, int height);
+
+	//nearest hit along the ray, kind is None if it misses everything
+	Hit cast(const Ray& ray) const;
+
+	//texture coordinate of the water at a world position, as the surface maps it
+	glm::vec2 waterUV(const glm::vec3& position) const;
+
+	//the pool is halfSize around the origin in x and z, from floor to top
+	float halfSize = 100.0f;
+	float floor = -50.0f;
+	float top = 50.0f;
+	float waterLevel = 0.0f;
+
+	//height of the displaced surface above waterLevel at a world xz, the ray is then
+	//refined against it inside waveBound of the plane. Without it the plane is hit
+	std::function<float(const glm::vec2&)> waterHeight;
+	float waveBound = 0.0f;
+
+	//bounding volumes of the objects, filled by the owner every time they move
+	std::vector<BoxBounds> boxes;
+	std::vector<SphereBounds> spheres;
+
+	//picks and their average cost since the last report
+	void report(int every = 30);
+
+private:
+	//distance where the ray meets the water, negative if it does not
+	float castWater(const Ray& ray) const;
+
+	mutable int picks = 0;
+	mutable double pickUs = 0.0;
+};
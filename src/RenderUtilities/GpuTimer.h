@@ -0,0 +1,51 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <iostream>
+#include <string>
+
+#include "QueryRing.h"
+
+//GL_TIME_ELAPSED queries in a QueryRing, so timing never stalls the frame
+class GpuTimer
+{
+public:
+	GpuTimer(const std::string& name) :
+		name(name)
+	{
+	}
+
+	void begin()
+	{
+		this->queries.collect([this](GLuint64 elapsed, int count)
+		{
+			this->lastMs = elapsed / 1000000.0f / count;
+			this->totalMs += this->lastMs;
+			this->samples++;
+		});
+		this->queries.begin();
+	}
+	//count is how many passes of the same work the query spans, samples are per pass
+	void end(int count = 1)
+	{
+		this->queries.end(count);
+	}
+
+	//print the average over the collected samples every few samples
+	void report(int every = 120)
+	{
+		if (this->samples < every)
+			return;
+		std::cout << this->name << ": " << this->totalMs / this->samples << " ms" << std::endl;
+		this->totalMs = 0.0;
+		this->samples = 0;
+	}
+
+	float lastMs = 0.0f;
+
+private:
+	std::string name;
+	QueryRing<GL_TIME_ELAPSED> queries;
+	double totalMs = 0.0;
+	int samples = 0;
+};
@@ -0,0 +1,142 @@
+#pragma once
+#include <opencv2\opencv.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../Utilities/ThreadPool.h"
+
+//Decodes images on its own worker threads and hands them back to the GL thread.
+//load() returns right away, pump() runs the upload callbacks of everything decoded so far,
+//so the first frames appear while the rest is still being read from disk
+class ImageLoader
+{
+public:
+	//runs on the GL thread with the decoded pixels, empty if the file could not be read
+	typedef std::function<void(const cv::Mat&)> Upload;
+
+	//a separate pool so decoding never queues in front of the simulation bands
+	ImageLoader(unsigned int threads = std::thread::hardware_concurrency()) :
+		pool(threads)
+	{
+	}
+
+	//flags are the cv::imread ones, IMREAD_GRAYSCALE decodes heights straight to one channel
+	void load(const std::string& path, int flags, const Upload& upload)
+	{
+		if (!this->loading)
+		{
+			this->loading = true;
+			this->start = Clock::now();
+		}
+		this->outstanding++;
+		this->pool.enqueue([this, path, flags, upload]()
+		{
+			Job job;
+			job.path = path;
+			job.upload = upload;
+			Clock::time_point begin = Clock::now();
+			job.pixels = cv::imread(path, flags);
+			job.decodeMs = milliseconds(begin, Clock::now());
+			if (job.pixels.empty())
+				printf("ImageLoader: could not read %s\n", path.c_str());
+
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->ready.push_back(std::move(job));
+		});
+	}
+
+	//GL thread, uploads everything decoded so far and returns how many loads are still outstanding
+	int pump()
+	{
+		std::vector<Job> jobs;
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			jobs.swap(this->ready);
+		}
+		for (Job& job : jobs)
+		{
+			Clock::time_point begin = Clock::now();
+			job.upload(job.pixels);
+			Timing timing;
+			timing.path = job.path;
+			timing.decodeMs = job.decodeMs;
+			timing.uploadMs = milliseconds(begin, Clock::now());
+			this->timings.push_back(timing);
+			this->outstanding--;
+		}
+		if (this->loading && this->outstanding == 0)
+		{
+			this->loading = false;
+			this->report(milliseconds(this->start, Clock::now()));
+		}
+		return this->outstanding;
+	}
+
+	int pending() const
+	{
+		return this->outstanding;
+	}
+
+	static ImageLoader& shared()
+	{
+		static ImageLoader loader;
+		return loader;
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Job
+	{
+		std::string path;
+		cv::Mat pixels;
+		Upload upload;
+		double decodeMs = 0.0;
+	};
+	struct Timing
+	{
+		std::string path;
+		double decodeMs;
+		double uploadMs;
+	};
+
+	static double milliseconds(Clock::time_point begin, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - begin).count();
+	}
+
+	//per file times of the batch that just finished, then the totals
+	void report(double wallMs)
+	{
+		double decodeMs = 0.0;
+		double uploadMs = 0.0;
+		for (const Timing& timing : this->timings)
+		{
+			printf("ImageLoader: %-40s decode %7.2f ms upload %6.2f ms\n", timing.path.c_str(), timing.decodeMs, timing.uploadMs);
+			decodeMs += timing.decodeMs;
+			uploadMs += timing.uploadMs;
+		}
+		printf("ImageLoader: %d files on %u threads, decode %.1f ms total, upload %.1f ms total, %.1f ms wall\n",
+			(int)this->timings.size(), this->pool.size(), decodeMs, uploadMs, wallMs);
+		this->timings.clear();
+	}
+
+	std::mutex mutex;
+	std::vector<Job> ready;
+	std::atomic<int> outstanding{ 0 };
+
+	//only touched on the GL thread
+	bool loading = false;
+	Clock::time_point start;
+	std::vector<Timing> timings;
+
+	//last so the workers are joined before the queue they push to goes away
+	ThreadPool pool;
+};
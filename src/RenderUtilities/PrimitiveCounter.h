@@ -0,0 +1,51 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <iostream>
+#include <string>
+
+#include "QueryRing.h"
+
+//GL_PRIMITIVES_GENERATED queries in a QueryRing like GpuTimer, counts what the last
+//vertex stage emitted, after tessellation, without stalling the frame
+class PrimitiveCounter
+{
+public:
+	PrimitiveCounter(const std::string& name) :
+		name(name)
+	{
+	}
+
+	void begin()
+	{
+		this->queries.collect([this](GLuint64 primitives, int)
+		{
+			this->last = primitives;
+			this->total += primitives;
+			this->samples++;
+		});
+		this->queries.begin();
+	}
+	void end()
+	{
+		this->queries.end();
+	}
+
+	//print the average count over the collected samples every few samples
+	void report(int every = 120)
+	{
+		if (this->samples < every)
+			return;
+		std::cout << this->name << ": " << (double)this->total / this->samples << " primitives" << std::endl;
+		this->total = 0;
+		this->samples = 0;
+	}
+
+	GLuint64 last = 0;
+
+private:
+	std::string name;
+	QueryRing<GL_PRIMITIVES_GENERATED> queries;
+	GLuint64 total = 0;
+	int samples = 0;
+};
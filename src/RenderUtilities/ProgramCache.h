@@ -0,0 +1,210 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/stat.h>
+extern "C" void* glXGetProcAddressARB(const unsigned char* name);
+#endif
+
+//KHR/ARB_parallel_shader_compile, the glad loader was not generated with either
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+//Linked programs kept on disk with glGetProgramBinary, one file per program named after
+//a hash of its stage sources and the driver strings, so a new driver or an edited shader
+//simply misses. Loading a hit is a glProgramBinary instead of a compile and link
+class ProgramCache
+{
+public:
+	//stage type and the source after includes are expanded
+	typedef std::vector<std::pair<GLenum, std::string>> Sources;
+
+	ProgramCache(const std::string& directory = "shader_cache") :
+		directory(directory)
+	{
+	}
+
+	//needs a current context, the first call also starts the driver's compiler threads
+	static ProgramCache& shared()
+	{
+		static ProgramCache cache;
+		if (!cache.initialized)
+			cache.initialize();
+		return cache;
+	}
+
+	uint64_t key(const Sources& sources) const
+	{
+		uint64_t hash = this->driverHash;
+		for (const auto& stage : sources)
+		{
+			hash = fnv(&stage.first, sizeof(stage.first), hash);
+			hash = fnv(stage.second.data(), stage.second.size(), hash);
+		}
+		return hash;
+	}
+
+	//true if the program was linked from a stored binary
+	bool load(uint64_t key, GLuint program)
+	{
+		if (!this->enabled)
+			return false;
+		FILE* file = fopen(this->path(key).c_str(), "rb");
+		if (!file)
+		{
+			this->misses++;
+			return false;
+		}
+		uint32_t header[2] = { 0, 0 };		//format, length
+		std::vector<unsigned char> binary;
+		if (fread(header, sizeof(header), 1, file) == 1)
+		{
+			//the stored length has to be what follows the header, a truncated or corrupt file is a miss
+			long start = ftell(file);
+			long remaining = (start >= 0 && fseek(file, 0, SEEK_END) == 0) ? ftell(file) - start : -1;
+			if (remaining > 0 && (uint64_t)remaining == header[1] && fseek(file, start, SEEK_SET) == 0)
+			{
+				binary.resize(header[1]);
+				if (fread(binary.data(), 1, binary.size(), file) != binary.size())
+					binary.clear();
+			}
+		}
+		fclose(file);
+
+		GLint success = GL_FALSE;
+		if (!binary.empty())
+		{
+			glProgramBinary(program, header[0], binary.data(), (GLsizei)binary.size());
+			glGetProgramiv(program, GL_LINK_STATUS, &success);
+		}
+		//the driver may refuse binaries of another build, the program is compiled again then
+		if (success)
+			this->hits++;
+		else
+			this->misses++;
+		return success == GL_TRUE;
+	}
+
+	//after a successful link of a program made with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+	void store(uint64_t key, GLuint program)
+	{
+		if (!this->enabled)
+			return;
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+		std::vector<unsigned char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(program, length, &length, &format, binary.data());
+
+		this->makeDirectory();
+		FILE* file = fopen(this->path(key).c_str(), "wb");
+		if (!file)
+			return;
+		uint32_t header[2] = { format, (uint32_t)length };
+		fwrite(header, sizeof(header), 1, file);
+		fwrite(binary.data(), 1, length, file);
+		fclose(file);
+		this->stores++;
+	}
+
+	bool isEnabled() const { return this->enabled; }
+	//programs can be polled with GL_COMPLETION_STATUS_KHR instead of blocking on the link
+	bool hasParallelCompile() const { return this->parallelCompile; }
+
+	int hits = 0;
+	int misses = 0;
+	int stores = 0;
+
+private:
+	typedef void (APIENTRYP MaxShaderCompilerThreads)(GLuint count);
+
+	static uint64_t fnv(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		return hash;
+	}
+
+	static void* getProc(const char* name)
+	{
+#ifdef _WIN32
+		return (void*)wglGetProcAddress(name);
+#else
+		return glXGetProcAddressARB((const unsigned char*)name);
+#endif
+	}
+
+	void initialize()
+	{
+		this->initialized = true;
+		const GLenum strings[4] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+		for (GLenum name : strings)
+		{
+			const char* value = (const char*)glGetString(name);
+			if (value)
+				this->driverHash = fnv(value, strlen(value), this->driverHash);
+		}
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		this->enabled = formats > 0;
+
+		GLint extensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+		for (GLint i = 0; i < extensions; i++)
+		{
+			std::string extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			const char* function = nullptr;
+			if (extension == "GL_KHR_parallel_shader_compile")
+				function = "glMaxShaderCompilerThreadsKHR";
+			else if (extension == "GL_ARB_parallel_shader_compile")
+				function = "glMaxShaderCompilerThreadsARB";
+			MaxShaderCompilerThreads maxThreads = function ? (MaxShaderCompilerThreads)getProc(function) : nullptr;
+			if (maxThreads)
+			{
+				//as many threads as the driver wants
+				maxThreads(0xFFFFFFFF);
+				this->parallelCompile = true;
+				break;
+			}
+		}
+	}
+
+	std::string path(uint64_t key) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+		return this->directory + name;
+	}
+
+	void makeDirectory() const
+	{
+#ifdef _WIN32
+		_mkdir(this->directory.c_str());
+#else
+		mkdir(this->directory.c_str(), 0755);
+#endif
+	}
+
+	std::string directory;
+	bool initialized = false;
+	bool enabled = false;
+	bool parallelCompile = false;
+	uint64_t driverHash = 14695981039346656037ull;
+};
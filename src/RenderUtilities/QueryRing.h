@@ -0,0 +1,57 @@
+#pragma once
+#include <glad/glad.h>
+
+//Queries of one target in a small ring, results are only read back once the driver says
+//they are available so measuring never stalls the frame. GpuTimer and PrimitiveCounter
+//keep their sums on top of it
+template <GLenum TARGET>
+class QueryRing
+{
+public:
+	static const int QUERY_AMOUNT = 4;
+
+	//every query still in flight, skip this sample instead of waiting
+	void begin()
+	{
+		if (!this->queries[0])
+			glGenQueries(QUERY_AMOUNT, this->queries);
+		this->running = this->inFlight < QUERY_AMOUNT;
+		if (this->running)
+			glBeginQuery(TARGET, this->queries[this->head]);
+	}
+	//count is how many passes of the same work the query spans
+	void end(int count = 1)
+	{
+		if (!this->running)
+			return;
+		glEndQuery(TARGET);
+		this->counts[this->head] = count > 0 ? count : 1;
+		this->head = (this->head + 1) % QUERY_AMOUNT;
+		this->inFlight++;
+		this->running = false;
+	}
+	//hands every finished query to result(value, count), oldest first
+	template <typename Result>
+	void collect(Result result)
+	{
+		while (this->inFlight > 0)
+		{
+			int index = (this->head + QUERY_AMOUNT - this->inFlight) % QUERY_AMOUNT;
+			GLint available = 0;
+			glGetQueryObjectiv(this->queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				break;
+			GLuint64 value = 0;
+			glGetQueryObjectui64v(this->queries[index], GL_QUERY_RESULT, &value);
+			result(value, this->counts[index]);
+			this->inFlight--;
+		}
+	}
+
+private:
+	GLuint queries[QUERY_AMOUNT] = { 0 };
+	int counts[QUERY_AMOUNT] = { 1, 1, 1, 1 };
+	int head = 0;
+	int inFlight = 0;
+	bool running = false;
+};
@@ -5,12 +5,19 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <memory>
+#include <typeindex>
+#include <unordered_map>
 #include <vector>
 
+#include "ProgramCache.h"
+#include "ShaderSources.h"
 
 
 class Shader
@@ -24,48 +31,73 @@ public:
 		TESS_EVALUATION_SHADER = (1 << 2),
 		GEOMETRY_SHADER = (1 << 3),
 		FRAGMENT_SHADER = (1 << 4),
+		COMPUTE_SHADER = (1 << 5),
 	};
 	//DEFINE_ENUM_FLAG_OPERATORS(Type);
 
 	Type type = NULL_SHADER;
-	// Constructor generates the shader on the fly
-	Shader(const GLchar* vert, const GLchar* tesc, const GLchar* tese, const char* geom, const char* frag)
+	// Constructor generates the shader on the fly, every define ("NAME" or "NAME value")
+	// goes right after the #version line of each stage
+	Shader(const GLchar* vert, const GLchar* tesc, const GLchar* tese, const char* geom, const char* frag,
+		const std::vector<std::string>& defines = std::vector<std::string>())
 	{
-		std::vector<GLuint> shaders;
+		ProgramCache::Sources sources;
 		if (vert)
 		{
-			shaders.push_back(this->compileShader(GL_VERTEX_SHADER, this->readCode(vert).c_str()));
+			sources.push_back(std::make_pair(GL_VERTEX_SHADER, this->addDefines(this->readCode(vert), defines)));
 			this->type = (Shader::Type)(this->type | Type::VERTEX_SHADER);
 		}
 		if (tesc)
 		{
-			shaders.push_back(this->compileShader(GL_TESS_CONTROL_SHADER, this->readCode(tesc).c_str()));
+			sources.push_back(std::make_pair(GL_TESS_CONTROL_SHADER, this->addDefines(this->readCode(tesc), defines)));
 			this->type = (Shader::Type)(this->type | Type::TESS_CONTROL_SHADER);
 		}
 		if (tese)
 		{
-			shaders.push_back(this->compileShader(GL_TESS_EVALUATION_SHADER, this->readCode(tese).c_str()));
+			sources.push_back(std::make_pair(GL_TESS_EVALUATION_SHADER, this->addDefines(this->readCode(tese), defines)));
 			this->type = (Shader::Type)(this->type | Type::TESS_EVALUATION_SHADER);
 		}
 		if (geom)
 		{
-			shaders.push_back(this->compileShader(GL_GEOMETRY_SHADER, this->readCode(geom).c_str()));
+			sources.push_back(std::make_pair(GL_GEOMETRY_SHADER, this->addDefines(this->readCode(geom), defines)));
 			this->type = (Shader::Type)(this->type | Type::GEOMETRY_SHADER);
 		}
 		if (frag)
 		{
-			shaders.push_back(this->compileShader(GL_FRAGMENT_SHADER, this->readCode(frag).c_str()));
+			sources.push_back(std::make_pair(GL_FRAGMENT_SHADER, this->addDefines(this->readCode(frag), defines)));
 			this->type = (Shader::Type)(this->type | Type::FRAGMENT_SHADER);
 		}
-		// Shader Program
+		this->build(sources);
+	}
+	// Compute only program
+	Shader(const GLchar* comp, const std::vector<std::string>& defines = std::vector<std::string>())
+	{
+		ProgramCache::Sources sources;
+		sources.push_back(std::make_pair(GL_COMPUTE_SHADER, this->addDefines(this->readCode(comp), defines)));
+		this->type = Type::COMPUTE_SHADER;
+		this->build(sources);
+	}
+	// False while the driver is still compiling on its own threads, true right away without
+	// parallel shader compile since asking would only block
+	bool isReady() const
+	{
+		if (this->finished || !ProgramCache::shared().hasParallelCompile())
+			return true;
+		GLint done = GL_FALSE;
+		glGetProgramiv(this->Program, GL_COMPLETION_STATUS_KHR, &done);
+		return done == GL_TRUE;
+	}
+	// Prints compile and link errors and stores the binary, blocks until the link is done
+	void finish()
+	{
+		if (this->finished)
+			return;
+		this->finished = true;
+		for (const auto& stage : this->stages)
+			this->checkShader(stage.first, stage.second);
+
 		GLint success;
 		GLchar infoLog[512];
-		this->Program = glCreateProgram();
-
-		for (GLuint shader : shaders)
-			glAttachShader(this->Program, shader);
-
-		glLinkProgram(this->Program);
 		// Print linking errors if any
 		glGetProgramiv(this->Program, GL_LINK_STATUS, &success);
 		if (!success)
@@ -73,74 +105,161 @@ public:
 			glGetProgramInfoLog(this->Program, 512, NULL, infoLog);
 			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 		}
+		else
+		{
+			ProgramCache::shared().store(this->cacheKey, this->Program);
+			this->reflect();
+		}
 
-		for (GLuint shader : shaders)
-			glDeleteShader(shader);
+		for (const auto& stage : this->stages)
+			glDeleteShader(stage.second);
+		this->stages.clear();
 	}
 	// Uses the current shader
 	void Use()
 	{
+		this->finish();
 		glUseProgram(this->Program);
 	}
-	//From learnopengl.com
-	void setBool(const std::string &name, bool value) const
-	{
-		glUniform1i(glGetUniformLocation(this->Program, name.c_str()), (int)value);
-	}
-	void setInt(const std::string &name, int value) const
-	{
-		glUniform1i(glGetUniformLocation(this->Program, name.c_str()), value);
-	}
-	void setFloat(const std::string &name, float value) const
-	{
-		glUniform1f(glGetUniformLocation(this->Program, name.c_str()), value);
-	}
-	 void setVec2(const std::string &name, const glm::vec2 &value) const
-    { 
-        glUniform2fv(glGetUniformLocation(this->Program, name.c_str()), 1, &value[0]); 
-    }
-    void setVec2(const std::string &name, float x, float y) const
-    { 
-        glUniform2f(glGetUniformLocation(this->Program, name.c_str()), x, y); 
-    }
-    // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
-    { 
-        glUniform3fv(glGetUniformLocation(this->Program, name.c_str()), 1, &value[0]); 
-    }
-    void setVec3(const std::string &name, float x, float y, float z) const
-    { 
-        glUniform3f(glGetUniformLocation(this->Program, name.c_str()), x, y, z); 
-    }
-    // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
-    { 
-        glUniform4fv(glGetUniformLocation(this->Program, name.c_str()), 1, &value[0]); 
-    }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
-    { 
-        glUniform4f(glGetUniformLocation(this->Program, name.c_str()), x, y, z, w); 
-    }
-    // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
-    {
-        glUniformMatrix2fv(glGetUniformLocation(this->Program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-    }
-    // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
-    {
-        glUniformMatrix3fv(glGetUniformLocation(this->Program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-    }
-    // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
-    {
-        glUniformMatrix4fv(glGetUniformLocation(this->Program, name.c_str()), 1, GL_FALSE, &mat[0][0]);
-    }
+	// A uniform resolved once by name, -1 when the program does not use it. The type has to
+	// match the declaration, set() with it neither looks the name up nor uploads an unchanged value
+	template <typename T>
+	struct Uniform
+	{
+		int index = -1;
+	};
+	template <typename T>
+	Uniform<T> uniform(const std::string& name)
+	{
+		this->finish();
+		Uniform<T> handle;
+		auto found = this->uniformIndex.find(name);
+		if (found == this->uniformIndex.end())
+			return handle;
+		UniformInfo& info = this->uniforms[found->second];
+		if (!accepts(info.type, (const T*)nullptr))
+		{
+			if (!info.mismatched)
+				std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH " << name << std::endl;
+			info.mismatched = true;
+			return handle;
+		}
+		handle.index = found->second;
+		return handle;
+	}
+	template <typename T>
+	void set(Uniform<T> handle, const T& value)
+	{
+		if (this->changed(handle.index, &value, sizeof(T)))
+			upload(this->uniforms[handle.index].location, value);
+	}
+
+	// A set of handles kept with the program, constructed from the shader the first time it is
+	// asked for, so callers switching between variants resolve every name only once per program
+	template <typename Handles>
+	const Handles& handles()
+	{
+		this->finish();
+		std::shared_ptr<void>& set = this->handleSets[std::type_index(typeid(Handles))];
+		if (!set)
+			set = std::make_shared<Handles>(this);
+		return *(const Handles*)set.get();
+	}
+	// u_model of the object draws, resolved with the program
+	void setModel(const glm::mat4& model)
+	{
+		this->finish();
+		this->set(this->modelUniform, model);
+	}
+
+	// glUniform calls made and skipped because the program already held the value
+	struct UniformCounters
+	{
+		int uploads = 0;
+		int unchanged = 0;
+		int frames = 0;
+	};
+	static UniformCounters& uniformCounters()
+	{
+		static UniformCounters counters;
+		return counters;
+	}
+	// call once a frame, prints the averages every few frames
+	static void reportUniforms(int every = 120)
+	{
+		UniformCounters& counters = uniformCounters();
+		if (++counters.frames < every)
+			return;
+		std::cout << "Uniforms per frame: " << (float)counters.uploads / counters.frames << " uploaded, "
+			<< (float)counters.unchanged / counters.frames << " unchanged" << std::endl;
+		counters = UniformCounters();
+	}
+
+	//From learnopengl.com, by name through the reflected table
+	void setBool(const std::string &name, bool value)
+	{
+		this->set(this->uniform<int>(name), (int)value);
+	}
+	void setInt(const std::string &name, int value)
+	{
+		this->set(this->uniform<int>(name), value);
+	}
+	void setFloat(const std::string &name, float value)
+	{
+		this->set(this->uniform<float>(name), value);
+	}
+	void setVec2(const std::string &name, const glm::vec2 &value)
+	{
+		this->set(this->uniform<glm::vec2>(name), value);
+	}
+	void setVec2(const std::string &name, float x, float y)
+	{
+		this->setVec2(name, glm::vec2(x, y));
+	}
+	// ------------------------------------------------------------------------
+	void setVec3(const std::string &name, const glm::vec3 &value)
+	{
+		this->set(this->uniform<glm::vec3>(name), value);
+	}
+	void setVec3(const std::string &name, float x, float y, float z)
+	{
+		this->setVec3(name, glm::vec3(x, y, z));
+	}
+	// ------------------------------------------------------------------------
+	void setVec4(const std::string &name, const glm::vec4 &value)
+	{
+		this->set(this->uniform<glm::vec4>(name), value);
+	}
+	void setVec4(const std::string &name, float x, float y, float z, float w)
+	{
+		this->setVec4(name, glm::vec4(x, y, z, w));
+	}
+	// ------------------------------------------------------------------------
+	void setMat2(const std::string &name, const glm::mat2 &mat)
+	{
+		this->set(this->uniform<glm::mat2>(name), mat);
+	}
+	// ------------------------------------------------------------------------
+	void setMat3(const std::string &name, const glm::mat3 &mat)
+	{
+		this->set(this->uniform<glm::mat3>(name), mat);
+	}
+	// ------------------------------------------------------------------------
+	void setMat4(const std::string &name, const glm::mat4 &mat)
+	{
+		this->set(this->uniform<glm::mat4>(name), mat);
+	}
 	//End
 private:
 	std::string readCode(const GLchar* path)
 	{
 		std::string code;
+		// the copy built into the executable, the file is only read for shaders not embedded
+		std::string name = path;
+		const char* embedded = ShaderSources::find(name.substr(name.find_last_of("/\\") + 1));
+		if (embedded)
+			return this->expandIncludes(embedded, path);
+
 		std::ifstream shader_file;
 		// ensures ifstream objects can throw exceptions:
 		shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
@@ -162,17 +281,77 @@ private:
 			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 			std::cout << path << std::endl;
 		}
-		return code;
+		return this->expandIncludes(code, path);
+	}
+	// Replaces #include "file" lines with the file, paths are relative to the including file
+	std::string expandIncludes(const std::string& code, const GLchar* path)
+	{
+		std::string directory = path;
+		directory = directory.substr(0, directory.find_last_of("/\\") + 1);
+
+		std::string expanded;
+		std::istringstream lines(code);
+		std::string line;
+		while (std::getline(lines, line))
+		{
+			size_t directive = line.find("#include");
+			size_t open = line.find('"', directive);
+			size_t close = (open == std::string::npos) ? open : line.find('"', open + 1);
+			if (directive != std::string::npos && close != std::string::npos)
+				expanded += this->readCode((directory + line.substr(open + 1, close - open - 1)).c_str());
+			else
+				expanded += line + "\n";
+		}
+		return expanded;
+	}
+	// #version has to stay the first line, the defines go right after it
+	std::string addDefines(const std::string& code, const std::vector<std::string>& defines)
+	{
+		if (defines.empty())
+			return code;
+		std::string lines;
+		for (const std::string& define : defines)
+			lines += "#define " + define + "\n";
+		size_t version = code.find("#version");
+		size_t insert = (version == std::string::npos) ? std::string::npos : code.find('\n', version);
+		if (insert == std::string::npos)
+			return lines + code;
+		return code.substr(0, insert + 1) + lines + code.substr(insert + 1);
+	}
+	// Links from the cache when it can, otherwise only issues the compile and link, nothing
+	// asks for their results until finish() so the driver can work on every program at once
+	void build(const ProgramCache::Sources& sources)
+	{
+		ProgramCache& cache = ProgramCache::shared();
+		this->Program = glCreateProgram();
+		this->cacheKey = cache.key(sources);
+		if (cache.load(this->cacheKey, this->Program))
+		{
+			this->finished = true;
+			this->reflect();
+			return;
+		}
+
+		for (const auto& source : sources)
+			this->stages.push_back(std::make_pair(source.first, this->compileShader(source.first, source.second.c_str())));
+		for (const auto& stage : this->stages)
+			glAttachShader(this->Program, stage.second);
+		glProgramParameteri(this->Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(this->Program);
 	}
 	GLuint compileShader(GLenum shader_type, const char* code)
 	{
 		GLuint shader_number;
-		GLint success;
-		GLchar infoLog[512];
 		// Vertex Shader
 		shader_number = glCreateShader(shader_type);
 		glShaderSource(shader_number, 1, &code, NULL);
 		glCompileShader(shader_number);
+		return shader_number;
+	}
+	void checkShader(GLenum shader_type, GLuint shader_number)
+	{
+		GLint success;
+		GLchar infoLog[512];
 		// Print compile errors if any
 		glGetShaderiv(shader_number, GL_COMPILE_STATUS, &success);
 		if (!success)
@@ -188,9 +367,115 @@ private:
 				std::cout << "ERROR::SHADER::GEOMETRY::COMPILATION_FAILED\n" << infoLog << std::endl;
 			else if (shader_type == GL_FRAGMENT_SHADER)
 				std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+			else if (shader_type == GL_COMPUTE_SHADER)
+				std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
 		}
-		return shader_number;
 	}
+
+	// Every active uniform outside a block, array elements under "name[i]" as well as the
+	// first one under "name", so setters never ask the driver for a location
+	void reflect()
+	{
+		GLint count = 0, length = 0;
+		glGetProgramiv(this->Program, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(this->Program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &length);
+		std::vector<GLchar> buffer(std::max(length, 1));
+		for (GLint i = 0; i < count; i++)
+		{
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(this->Program, i, (GLsizei)buffer.size(), NULL, &size, &type, buffer.data());
+			std::string name = buffer.data();
+			size_t bracket = name.rfind("[0]");
+			bool array = bracket != std::string::npos && bracket + 3 == name.size();
+			if (array)
+				name = name.substr(0, bracket);
+			for (GLint element = 0; element < size; element++)
+			{
+				std::string elementName = array ? name + "[" + std::to_string(element) + "]" : name;
+				GLint location = glGetUniformLocation(this->Program, elementName.c_str());
+				if (location < 0)
+					continue;
+				UniformInfo info;
+				info.location = location;
+				info.type = type;
+				this->uniformIndex[elementName] = (int)this->uniforms.size();
+				if (array && element == 0)
+					this->uniformIndex[name] = (int)this->uniforms.size();
+				this->uniforms.push_back(info);
+			}
+		}
+		this->modelUniform = this->uniform<glm::mat4>("u_model");
+	}
+	// Whether a uniform of that GL type is set with a T, int also sets bools and the units of samplers and images
+	static bool accepts(GLenum type, const int*) { return type == GL_INT || type == GL_BOOL || isOpaque(type); }
+	static bool accepts(GLenum type, const float*) { return type == GL_FLOAT; }
+	static bool accepts(GLenum type, const glm::vec2*) { return type == GL_FLOAT_VEC2; }
+	static bool accepts(GLenum type, const glm::vec3*) { return type == GL_FLOAT_VEC3; }
+	static bool accepts(GLenum type, const glm::vec4*) { return type == GL_FLOAT_VEC4; }
+	static bool accepts(GLenum type, const glm::mat2*) { return type == GL_FLOAT_MAT2; }
+	static bool accepts(GLenum type, const glm::mat3*) { return type == GL_FLOAT_MAT3; }
+	static bool accepts(GLenum type, const glm::mat4*) { return type == GL_FLOAT_MAT4; }
+	static bool isOpaque(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+		case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_1D_ARRAY_SHADOW: case GL_SAMPLER_2D_ARRAY_SHADOW:
+		case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_2D_MULTISAMPLE_ARRAY: case GL_SAMPLER_BUFFER:
+		case GL_SAMPLER_2D_RECT: case GL_SAMPLER_2D_RECT_SHADOW:
+		case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_3D: case GL_INT_SAMPLER_CUBE: case GL_INT_SAMPLER_2D_ARRAY:
+		case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_3D: case GL_UNSIGNED_INT_SAMPLER_CUBE: case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+		case GL_IMAGE_2D: case GL_IMAGE_3D: case GL_IMAGE_CUBE: case GL_IMAGE_2D_ARRAY:
+		case GL_INT_IMAGE_2D: case GL_UNSIGNED_INT_IMAGE_2D:
+			return true;
+		default:
+			return false;
+		}
+	}
+	// Compares against the copy of what the program holds and keeps the new value
+	bool changed(int index, const void* value, size_t size)
+	{
+		if (index < 0)
+			return false;
+		UniformInfo& info = this->uniforms[index];
+		if (info.set && memcmp(info.value, value, size) == 0)
+		{
+			uniformCounters().unchanged++;
+			return false;
+		}
+		memcpy(info.value, value, size);
+		info.set = true;
+		uniformCounters().uploads++;
+		return true;
+	}
+	static void upload(GLint location, int value) { glUniform1i(location, value); }
+	static void upload(GLint location, float value) { glUniform1f(location, value); }
+	static void upload(GLint location, const glm::vec2& value) { glUniform2fv(location, 1, &value[0]); }
+	static void upload(GLint location, const glm::vec3& value) { glUniform3fv(location, 1, &value[0]); }
+	static void upload(GLint location, const glm::vec4& value) { glUniform4fv(location, 1, &value[0]); }
+	static void upload(GLint location, const glm::mat2& value) { glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]); }
+	static void upload(GLint location, const glm::mat3& value) { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+	static void upload(GLint location, const glm::mat4& value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+
+	struct UniformInfo
+	{
+		GLint location = -1;
+		GLenum type = 0;
+		bool set = false;
+		bool mismatched = false;
+		unsigned char value[sizeof(glm::mat4)];
+	};
+	std::vector<UniformInfo> uniforms;
+	Uniform<glm::mat4> modelUniform;
+	std::unordered_map<std::type_index, std::shared_ptr<void>> handleSets;
+	std::unordered_map<std::string, int> uniformIndex;
+
+	// stages still waiting for finish(), empty once the program is done
+	std::vector<std::pair<GLenum, GLuint>> stages;
+	uint64_t cacheKey = 0;
+	bool finished = false;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+
+//The files in src/shaders, compiled into the executable by cmake/EmbedShaders.cmake
+//so the programs don't depend on the working directory
+namespace ShaderSources
+{
+	//contents of the file with that name, without its directory, NULL if it was not embedded
+	const char* find(const std::string& name);
+}
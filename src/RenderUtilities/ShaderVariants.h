@@ -0,0 +1,159 @@
+#pragma once
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GpuTimer.h"
+#include "Shader.h"
+
+//One program per combination of #define keys, bit i of a mask turns on keys[i]. Variants also
+//get VARIANT and the shared defines, so the shaders drop whatever the keys leave out. The
+//generic program is compiled without any of them and switches on uniforms instead, it draws
+//until the variant of the current mask is linked so a new combination never waits
+class ShaderVariants
+{
+public:
+	ShaderVariants(const std::string& name, const char* vert, const char* tesc, const char* tese, const char* geom, const char* frag,
+		const std::vector<std::string>& keys, const std::vector<std::string>& defines = std::vector<std::string>()) :
+		name(name), keys(keys), defines(defines)
+	{
+		const char* paths[5] = { vert, tesc, tese, geom, frag };
+		for (int i = 0; i < 5; i++)
+			this->paths[i] = paths[i] ? paths[i] : "";
+		this->generic.reset(new Variant(this->create(nullptr), name + " [generic]"));
+		this->current = this->generic.get();
+	}
+
+	unsigned int bit(const std::string& key) const
+	{
+		for (size_t i = 0; i < this->keys.size(); i++)
+		{
+			if (this->keys[i] == key)
+				return 1u << i;
+		}
+		return 0;
+	}
+
+	Shader* getGeneric() { return this->generic->shader.get(); }
+
+	//the variant of the mask once it is linked, the generic program until then. Without
+	//parallel shader compile a variant is made here the first time it is asked for
+	Shader* get(unsigned int mask)
+	{
+		Variant& variant = this->variant(mask);
+		this->current = variant.shader->isReady() ? &variant : this->generic.get();
+		return this->current->shader.get();
+	}
+
+	//timer of the program the last get() returned
+	GpuTimer& timer() { return this->current->timer; }
+
+	//queues every mask that can be selected, update() starts a few of them each frame. Only
+	//where the driver compiles in parallel, elsewhere each compile would stall a frame
+	void precompile(const std::vector<unsigned int>& masks)
+	{
+		if (!ProgramCache::shared().hasParallelCompile())
+			return;
+		this->queue.insert(this->queue.end(), masks.begin(), masks.end());
+		this->precompileStart = std::chrono::high_resolution_clock::now();
+	}
+
+	//starts up to budget queued compiles and finishes the ones that are done, so their
+	//binaries reach the program cache even if they are never drawn with
+	void update(int budget = 4)
+	{
+		while (budget > 0 && !this->queue.empty())
+		{
+			unsigned int mask = this->queue.front();
+			this->queue.pop_front();
+			if (this->variants.count(mask))
+				continue;
+			this->compiling.push_back(this->variant(mask).shader.get());
+			budget--;
+		}
+		for (size_t i = 0; i < this->compiling.size();)
+		{
+			if (this->compiling[i]->isReady())
+			{
+				this->compiling[i]->finish();
+				this->compiling.erase(this->compiling.begin() + i);
+				this->precompiled++;
+			}
+			else
+				i++;
+		}
+		if (this->precompiled > 0 && this->queue.empty() && this->compiling.empty())
+		{
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - this->precompileStart).count();
+			std::cout << this->name << ": " << this->precompiled << " variants precompiled in " << ms << " ms" << std::endl;
+			this->precompiled = 0;
+		}
+	}
+
+	//average GPU time of every program drawn with since the last report
+	void report(int every = 120)
+	{
+		this->generic->timer.report(every);
+		for (auto& variant : this->variants)
+			variant.second->timer.report(every);
+	}
+
+private:
+	struct Variant
+	{
+		Variant(Shader* shader, const std::string& name) :
+			shader(shader), timer(name)
+		{
+		}
+		std::unique_ptr<Shader> shader;
+		GpuTimer timer;
+	};
+
+	Variant& variant(unsigned int mask)
+	{
+		std::unique_ptr<Variant>& variant = this->variants[mask];
+		if (!variant)
+		{
+			std::vector<std::string> defines(1, "VARIANT");
+			defines.insert(defines.end(), this->defines.begin(), this->defines.end());
+			std::string name = this->name + " [";
+			for (size_t i = 0; i < this->keys.size(); i++)
+			{
+				if (mask & (1u << i))
+				{
+					defines.push_back(this->keys[i]);
+					name += (name.back() == '[' ? "" : " ") + this->keys[i];
+				}
+			}
+			variant.reset(new Variant(this->create(&defines), name + "]"));
+		}
+		return *variant;
+	}
+
+	Shader* create(const std::vector<std::string>* defines)
+	{
+		const char* paths[5];
+		for (int i = 0; i < 5; i++)
+			paths[i] = this->paths[i].empty() ? nullptr : this->paths[i].c_str();
+		return new Shader(paths[0], paths[1], paths[2], paths[3], paths[4],
+			defines ? *defines : std::vector<std::string>());
+	}
+
+	std::string name;
+	std::string paths[5];
+	std::vector<std::string> keys;
+	std::vector<std::string> defines;
+
+	std::unique_ptr<Variant> generic;
+	std::map<unsigned int, std::unique_ptr<Variant>> variants;
+	Variant* current = nullptr;
+
+	std::deque<unsigned int> queue;
+	std::vector<Shader*> compiling;
+	int precompiled = 0;
+	std::chrono::high_resolution_clock::time_point precompileStart;
+};
@@ -4,6 +4,8 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "ImageLoader.h"
+#include "../TexturePack.h"
 
 class Texture2D
 {
@@ -32,19 +34,115 @@ public:
 		glGenTextures(1, &this->id);
 
 		glBindTexture(GL_TEXTURE_2D, this->id);
-		glGenerateMipmap(GL_TEXTURE_2D);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		if(img.type() == CV_8UC3)
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, img.cols, img.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, img.data);
 		else if (img.type() == CV_8UC4)
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, img.cols, img.rows, 0, GL_BGRA, GL_UNSIGNED_BYTE, img.data);
+		//the chain is built from the uploaded level, so this has to come after it
+		glGenerateMipmap(GL_TEXTURE_2D);
 		glBindTexture(GL_TEXTURE_2D, 0);
 
 		img.release();
 	}
+	//All levels straight from a mapped pack, nothing is decoded or generated
+	Texture2D(const TexturePack& pack, const char* name, Type texture_type = Texture2D::TEXTURE_DEFAULT) :
+		type(texture_type)
+	{
+		glGenTextures(1, &this->id);
+
+		glActiveTexture(GL_TEXTURE0 + UPLOAD_UNIT);
+		glBindTexture(GL_TEXTURE_2D, this->id);
+		const TexturePack::Entry* entry = pack.find(name);
+		if (entry && entry->target == GL_TEXTURE_2D)
+		{
+			this->size = glm::ivec2(entry->width, entry->height);
+			this->format = entry->format;
+			this->pixel_type = entry->type;
+			pack.upload(*entry);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (entry && entry->levels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	//Empty texture that is filled from the CPU side with update()
+	Texture2D(int width, int height, GLenum internal_format, GLenum format, GLenum pixel_type, Type texture_type = Texture2D::TEXTURE_DEFAULT) :
+		type(texture_type), format(format), pixel_type(pixel_type)
+	{
+		this->size.x = width;
+		this->size.y = height;
+
+		glGenTextures(1, &this->id);
+
+		glActiveTexture(GL_TEXTURE0 + UPLOAD_UNIT);
+		glBindTexture(GL_TEXTURE_2D, this->id);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, pixel_type, NULL);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	//Returns a 1x1 texture right away, the image replaces it once the loader decoded it and
+	//ImageLoader::pump() ran on the GL thread. The texture has to outlive the load
+	static Texture2D* loadAsync(const char* path, Type texture_type = Texture2D::TEXTURE_DEFAULT, ImageLoader& loader = ImageLoader::shared())
+	{
+		Texture2D* texture = new Texture2D(1, 1, GL_RGB8, GL_BGR, GL_UNSIGNED_BYTE, texture_type);
+		texture->setWrap(GL_REPEAT);
+		loader.load(path, cv::IMREAD_COLOR, [texture](const cv::Mat& img) { texture->upload(img); });
+		return texture;
+	}
+	~Texture2D()
+	{
+		glDeleteTextures(1, &this->id);
+	}
+	void update(const void* data)
+	{
+		glActiveTexture(GL_TEXTURE0 + UPLOAD_UNIT);
+		glBindTexture(GL_TEXTURE_2D, this->id);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, this->size.x, this->size.y, this->format, this->pixel_type, data);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	//Reallocates with the size and channels of a decoded 8 bit image
+	void upload(const cv::Mat& img)
+	{
+		if (img.type() != CV_8UC3 && img.type() != CV_8UC4)
+			return;
+		bool alpha = img.type() == CV_8UC4;
+		this->size = glm::ivec2(img.cols, img.rows);
+		this->format = alpha ? GL_BGRA : GL_BGR;
+		this->pixel_type = GL_UNSIGNED_BYTE;
+
+		glActiveTexture(GL_TEXTURE0 + UPLOAD_UNIT);
+		glBindTexture(GL_TEXTURE_2D, this->id);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, alpha ? GL_RGBA8 : GL_RGB8, img.cols, img.rows, 0, this->format, GL_UNSIGNED_BYTE, img.data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	void setWrap(GLenum wrap)
+	{
+		glActiveTexture(GL_TEXTURE0 + UPLOAD_UNIT);
+		glBindTexture(GL_TEXTURE_2D, this->id);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	void clear()
+	{
+		glClearTexImage(this->id, 0, this->format, this->pixel_type, NULL);
+	}
+	void bindImage(GLuint image_unit, GLenum access, GLenum image_format)
+	{
+		glBindImageTexture(image_unit, this->id, 0, GL_FALSE, 0, access, image_format);
+	}
 	void bind(GLenum bind_unit)
 	{
 		glActiveTexture(GL_TEXTURE0 + bind_unit);
@@ -56,7 +154,12 @@ public:
 		glBindTexture(GL_TEXTURE_2D, 0);
 	}
 	glm::ivec2 size;
+
+	//creation and uploads bind here so the units used for drawing keep their textures
+	static const GLenum UPLOAD_UNIT = 15;
 private:
 	GLuint id;
+	GLenum format = GL_BGR;
+	GLenum pixel_type = GL_UNSIGNED_BYTE;
 
 };
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+#include <opencv2\opencv.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "ImageLoader.h"
+#include "../TexturePack.h"
+#include <string>
+#include <vector>
+
+//Stack of equally sized images in one GL_TEXTURE_3D, the third coordinate is the
+//slice so linear filtering blends neighbouring slices and GL_REPEAT loops them
+class Texture3D
+{
+public:
+	//Every level of a 3D or 2D array entry straight from a mapped pack. Block compressed
+	//stacks are arrays since RGTC can't be used with 3D textures, the shader then has to
+	//blend neighbouring layers itself
+	Texture3D(const TexturePack& pack, const char* name)
+	{
+		const TexturePack::Entry* entry = pack.find(name);
+		if (entry && entry->target != GL_TEXTURE_3D && entry->target != GL_TEXTURE_2D_ARRAY)
+			entry = nullptr;
+		if (entry)
+			this->target = entry->target;
+
+		glGenTextures(1, &this->id);
+
+		glActiveTexture(GL_TEXTURE0 + UPLOAD_UNIT);
+		glBindTexture(this->target, this->id);
+		if (entry)
+		{
+			this->size = glm::ivec3(entry->width, entry->height, entry->depth);
+			this->format = entry->format;
+			this->pixel_type = entry->type;
+			pack.upload(*entry);
+		}
+		glTexParameteri(this->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(this->target, GL_TEXTURE_MIN_FILTER, (entry && entry->levels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(this->target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(this->target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		if (this->target == GL_TEXTURE_3D)
+			glTexParameteri(this->target, GL_TEXTURE_WRAP_R, GL_REPEAT);
+		glBindTexture(this->target, 0);
+	}
+	//Empty texture that is filled slice by slice with updateSlice()
+	Texture3D(int width, int height, int depth, GLenum internal_format, GLenum format, GLenum pixel_type)
+	{
+		this->size = glm::ivec3(width, height, depth);
+		this->allocate(internal_format, format, pixel_type);
+	}
+	//Returns right away, storage is made when the first slice is decoded and slices are
+	//filled in as ImageLoader::pump() hands them over. The texture has to outlive the load
+	static Texture3D* loadAsync(const std::vector<std::string>& paths, ImageLoader& loader = ImageLoader::shared())
+	{
+		Texture3D* texture = new Texture3D((int)paths.size());
+		for (int i = 0; i < (int)paths.size(); i++)
+			loader.load(paths[i], cv::IMREAD_GRAYSCALE, [texture, i](const cv::Mat& img) { texture->uploadSlice(i, img); });
+		return texture;
+	}
+	~Texture3D()
+	{
+		glDeleteTextures(1, &this->id);
+	}
+	void updateSlice(int slice, const void* data)
+	{
+		glActiveTexture(GL_TEXTURE0 + UPLOAD_UNIT);
+		glBindTexture(GL_TEXTURE_3D, this->id);
+		glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, slice, this->size.x, this->size.y, 1, this->format, this->pixel_type, data);
+		glBindTexture(GL_TEXTURE_3D, 0);
+	}
+	//single channel slice, the first one to arrive decides the size of the stack
+	void uploadSlice(int slice, const cv::Mat& img)
+	{
+		if (img.type() != CV_8UC1 || !img.isContinuous())
+			return;
+		if (this->size.x == 0)
+		{
+			this->size.x = img.cols;
+			this->size.y = img.rows;
+			this->allocate(GL_R8, GL_RED, GL_UNSIGNED_BYTE);
+		}
+		if (img.cols != this->size.x || img.rows != this->size.y)
+			return;
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		this->updateSlice(slice, img.data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+	void bind(GLenum bind_unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + bind_unit);
+		glBindTexture(this->target, this->id);
+	}
+	void unbind(GLenum bind_unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + bind_unit);
+		glBindTexture(this->target, 0);
+	}
+	glm::ivec3 size;
+	//GL_TEXTURE_2D_ARRAY only for compressed stacks from a pack
+	GLenum target = GL_TEXTURE_3D;
+
+	static const GLenum UPLOAD_UNIT = 15;
+private:
+	//no storage until uploadSlice() sees the first image, sampling returns zero until then
+	Texture3D(int depth)
+	{
+		this->size = glm::ivec3(0, 0, depth);
+		glGenTextures(1, &this->id);
+	}
+	void allocate(GLenum internal_format, GLenum format, GLenum pixel_type)
+	{
+		this->format = format;
+		this->pixel_type = pixel_type;
+
+		if (!this->id)
+			glGenTextures(1, &this->id);
+
+		glActiveTexture(GL_TEXTURE0 + UPLOAD_UNIT);
+		glBindTexture(GL_TEXTURE_3D, this->id);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+		glTexImage3D(GL_TEXTURE_3D, 0, internal_format, this->size.x, this->size.y, this->size.z, 0, format, pixel_type, NULL);
+		glBindTexture(GL_TEXTURE_3D, 0);
+	}
+
+	GLuint id = 0;
+	GLenum format = GL_RED;
+	GLenum pixel_type = GL_UNSIGNED_BYTE;
+};
@@ -4,6 +4,8 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "ImageLoader.h"
+#include "../TexturePack.h"
 
 class TextureCube
 {
@@ -45,12 +47,64 @@ public:
 		}
 		glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_REPEAT);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	}
+	//All faces and levels straight from a mapped pack
+	TextureCube(const TexturePack& pack, const char* name, Type texture_type = TextureCube::TEXTURE_DEFAULT) :
+		type(texture_type)
+	{
+		glGenTextures(1, &this->id);
+
+		glActiveTexture(GL_TEXTURE0 + UPLOAD_UNIT);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, this->id);
+		const TexturePack::Entry* entry = pack.find(name);
+		if (entry && entry->target == GL_TEXTURE_CUBE_MAP)
+		{
+			this->size = glm::ivec2(entry->width, entry->height);
+			pack.upload(*entry);
+		}
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, (entry && entry->levels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_REPEAT);
 		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 	}
+	//Returns right away with 1x1 black faces, each face is replaced as the loader finishes it.
+	//The texture has to outlive the load
+	static TextureCube* loadAsync(const char* path[6], Type texture_type = TextureCube::TEXTURE_DEFAULT, ImageLoader& loader = ImageLoader::shared())
+	{
+		TextureCube* texture = new TextureCube(texture_type);
+		for (int i = 0; i < 6; i++)
+			loader.load(path[i], cv::IMREAD_COLOR, [texture, i](const cv::Mat& img) { texture->uploadFace(i, img); });
+		return texture;
+	}
+	//face in GL order, +x -x +y -y +z -z
+	void uploadFace(int face, const cv::Mat& img)
+	{
+		if (img.type() != CV_8UC3 && img.type() != CV_8UC4)
+			return;
+		bool alpha = img.type() == CV_8UC4;
+		this->size = glm::ivec2(img.cols, img.rows);
+
+		glActiveTexture(GL_TEXTURE0 + UPLOAD_UNIT);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, this->id);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, alpha ? GL_RGBA8 : GL_RGB8, img.cols, img.rows, 0,
+			alpha ? GL_BGRA : GL_BGR, GL_UNSIGNED_BYTE, img.data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		//the chain needs all six faces
+		if (++this->facesLoaded == 6)
+		{
+			glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		}
+		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	}
 	void bind(GLenum bind_unit)
 	{
 		glActiveTexture(GL_TEXTURE0 + bind_unit);
@@ -62,7 +116,31 @@ public:
 		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 	}
 	glm::ivec2 size;
+
+	static const GLenum UPLOAD_UNIT = 15;
 private:
+	//the cube stays incomplete, and samples black, until all faces have the same size
+	TextureCube(Type texture_type) :
+		type(texture_type)
+	{
+		const unsigned char black[3] = { 0, 0, 0 };
+		this->size = glm::ivec2(1, 1);
+
+		glGenTextures(1, &this->id);
+
+		glActiveTexture(GL_TEXTURE0 + UPLOAD_UNIT);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, this->id);
+		for (int i = 0; i < 6; i++)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB8, 1, 1, 0, GL_BGR, GL_UNSIGNED_BYTE, black);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_REPEAT);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	}
+
 	GLuint id;
+	int facesLoaded = 0;
 
 };
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "RippleLut.h"
+
+#include <cmath>
+
+RippleLut::RippleLut(int ringSize, int ageSize) :
+	ringSize(ringSize), ageSize(ageSize)
+{
+}
+
+//1.5 * sin(s * clamp(0.0125 * t_c, 0, 1)) / exp(0.1 * |s| + 0.05 * t_c), s = dist - t_c
+float RippleLut::profile(float offset, float age)
+{
+	float frequency = glm::clamp(0.0125f * age, 0.0f, 1.0f);
+	return 1.5f * std::sin(offset * frequency) * std::exp(-0.1f * std::abs(offset) - 0.05f * age);
+}
+
+float RippleLut::profileDerivative(float offset, float age)
+{
+	float frequency = glm::clamp(0.0125f * age, 0.0f, 1.0f);
+	float sign = (offset < 0.0f) ? -1.0f : 1.0f;
+	return 1.5f * std::exp(-0.1f * std::abs(offset) - 0.05f * age) *
+		(frequency * std::cos(offset * frequency) - 0.1f * sign * std::sin(offset * frequency));
+}
+
+Texture2D* RippleLut::getTexture()
+{
+	if (this->texture)
+		return this->texture;
+
+	//sampled at the texel centers so linear filtering reproduces the table exactly there
+	std::vector<float> table(this->ringSize * this->ageSize * 2);
+	for (int y = 0; y < this->ageSize; y++)
+	{
+		float age = (y + 0.5f) / this->ageSize * this->ageRange;
+		for (int x = 0; x < this->ringSize; x++)
+		{
+			float offset = ((x + 0.5f) / this->ringSize * 2.0f - 1.0f) * this->ringRange;
+			table[(y * this->ringSize + x) * 2] = profile(offset, age);
+			table[(y * this->ringSize + x) * 2 + 1] = profileDerivative(offset, age);
+		}
+	}
+	this->texture = new Texture2D(this->ringSize, this->ageSize, GL_RG16F, GL_RG, GL_FLOAT);
+	this->texture->update(table.data());
+	return this->texture;
+}
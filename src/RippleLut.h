@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+
+#include "RenderUtilities/Texture.h"
+
+//Table of the analytic ripple profile used by getSimCoord, indexed by ring offset
+//(dist - t_c) and age t_c. Both are in wavelength normalized units, so the table
+//does not depend on waveLen or Amp and is built once.
+//r = profile, g = derivative along the distance
+class RippleLut
+{
+public:
+	RippleLut(int ringSize = 1024, int ageSize = 512);
+
+	//generated and uploaded on first use, needs a current GL context
+	Texture2D* getTexture();
+
+	//offsets outside +-ringRange and ages past ageRange are treated as flat water
+	float ringRange = 96.0f;
+	float ageRange = 192.0f;
+
+	static float profile(float offset, float age);
+	static float profileDerivative(float offset, float age);
+
+private:
+	int ringSize;
+	int ageSize;
+	Texture2D* texture = nullptr;
+};
@@ -0,0 +1,31 @@
+#include "SurfaceBaker.h"
+
+Shader* SurfaceBaker::getShader()
+{
+	if (!this->shader)
+	{
+		this->shader = new Shader("../../src/shaders/surfaceBake.comp");
+	}
+	return this->shader;
+}
+
+void SurfaceBaker::bake(int resolution)
+{
+	if (resolution != this->resolution)
+	{
+		delete this->displacement;
+		delete this->normal;
+		this->displacement = new Texture2D(resolution, resolution, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+		this->normal = new Texture2D(resolution, resolution, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+		this->resolution = resolution;
+	}
+
+	this->timer.begin();
+	this->getShader()->Use();
+	this->displacement->bindImage(0, GL_WRITE_ONLY, GL_RGBA16F);
+	this->normal->bindImage(1, GL_WRITE_ONLY, GL_RGBA16F);
+	GLuint groups = (resolution + 15) / 16;
+	glDispatchCompute(groups, groups, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	this->timer.end();
+}
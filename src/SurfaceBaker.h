@@ -0,0 +1,27 @@
+#pragma once
+#include "RenderUtilities/GpuTimer.h"
+#include "RenderUtilities/Shader.h"
+#include "RenderUtilities/Texture.h"
+
+//Evaluates the selected wave model once per texel into a displacement and a normal
+//texture, so the tessellation shader only fetches and the wave cost follows the
+//bake resolution instead of the tessellation output
+class SurfaceBaker
+{
+public:
+	//compiled on first use, the caller sets the wave uniforms on it before bake()
+	Shader* getShader();
+	void bake(int resolution);
+
+	Texture2D* getDisplacement() { return this->displacement; }
+	Texture2D* getNormal() { return this->normal; }
+	int getResolution() const { return this->resolution; }
+
+	GpuTimer timer = GpuTimer("Surface bake");
+
+private:
+	Shader* shader = nullptr;
+	Texture2D* displacement = nullptr;
+	Texture2D* normal = nullptr;
+	int resolution = 0;
+};
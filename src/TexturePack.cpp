@@ -0,0 +1,245 @@
+#include "TexturePack.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool TexturePack::open(const std::string& path)
+{
+	this->close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER length;
+	HANDLE mapping = NULL;
+	if (GetFileSizeEx(file, &length) && length.QuadPart > 0)
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	this->file = file;
+	this->mapping = mapping;
+	this->length = (size_t)length.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info;
+	void* view = NULL;
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+	{
+		view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED)
+			view = NULL;
+		else
+			this->length = (size_t)info.st_size;
+	}
+	this->file = (void*)(intptr_t)fd;
+#endif
+	this->data = (const unsigned char*)view;
+	if (!this->data)
+	{
+		this->close();
+		return false;
+	}
+
+	//everything the entries point at has to be inside the file
+	this->header = (const Header*)this->data;
+	bool valid = this->length >= sizeof(Header) && memcmp(this->header->magic, "TPAK", 4) == 0 &&
+		this->header->version == VERSION &&
+		this->length >= sizeof(Header) + (uint64_t)this->header->count * sizeof(Entry);
+	if (valid)
+	{
+		this->entries = (const Entry*)(this->data + sizeof(Header));
+		for (uint32_t i = 0; i < this->header->count && valid; i++)
+		{
+			const Entry& entry = this->entries[i];
+			valid = isValid(entry);
+			//every level has to hold exactly what the GL call reads from it, written so nothing can wrap
+			for (uint32_t level = 0; level < entry.levels && valid; level++)
+				valid = entry.size[level] == levelBytes(entry, level) && entry.size[level] <= (uint64_t)INT32_MAX && entry.size[level] <= this->length &&
+					entry.offset[level] <= this->length - entry.size[level];
+		}
+	}
+	if (!valid)
+	{
+		printf("TexturePack: %s is not a valid version %u pack\n", path.c_str(), VERSION);
+		this->close();
+		return false;
+	}
+	return true;
+}
+
+void TexturePack::close()
+{
+#ifdef _WIN32
+	if (this->data)
+		UnmapViewOfFile(this->data);
+	if (this->mapping)
+		CloseHandle((HANDLE)this->mapping);
+	if (this->file)
+		CloseHandle((HANDLE)this->file);
+#else
+	if (this->data)
+		munmap((void*)this->data, this->length);
+	if (this->file)
+		::close((int)(intptr_t)this->file);
+#endif
+	this->data = nullptr;
+	this->length = 0;
+	this->header = nullptr;
+	this->entries = nullptr;
+	this->file = nullptr;
+	this->mapping = nullptr;
+}
+
+const TexturePack::Entry* TexturePack::find(const std::string& name) const
+{
+	if (!this->entries)
+		return nullptr;
+	for (uint32_t i = 0; i < this->header->count; i++)
+	{
+		if (strncmp(this->entries[i].name, name.c_str(), sizeof(this->entries[i].name)) == 0)
+			return &this->entries[i];
+	}
+	return nullptr;
+}
+
+glm::ivec3 TexturePack::levelSize(const Entry& entry, int level)
+{
+	glm::ivec3 size(glm::max((int)entry.width >> level, 1), glm::max((int)entry.height >> level, 1), (int)entry.depth);
+	//only real 3D textures shrink along the third axis, cube faces and 2D stay as they are
+	if (entry.target == GL_TEXTURE_3D)
+		size.z = glm::max((int)entry.depth >> level, 1);
+	return size;
+}
+
+//the shape of the entry has to be something upload() knows how to hand to GL
+bool TexturePack::isValid(const Entry& entry)
+{
+	const uint32_t largest = 1u << MAX_LEVELS;
+	if (entry.width < 1 || entry.height < 1 || entry.depth < 1 || entry.width > largest || entry.height > largest || entry.depth > largest)
+		return false;
+	switch (entry.target)
+	{
+	case GL_TEXTURE_2D:
+		if (entry.depth != 1)
+			return false;
+		break;
+	case GL_TEXTURE_CUBE_MAP:
+		if (entry.depth != 6 || entry.width != entry.height)
+			return false;
+		break;
+	case GL_TEXTURE_3D:
+	case GL_TEXTURE_2D_ARRAY:
+		break;
+	default:
+		return false;
+	}
+
+	//no more levels than the chain down to 1x1(x1) has
+	uint32_t extent = glm::max(entry.width, entry.height);
+	if (entry.target == GL_TEXTURE_3D)
+		extent = glm::max(extent, entry.depth);
+	uint32_t chain = 1;
+	while ((extent >> chain) > 0)
+		chain++;
+	return entry.levels >= 1 && entry.levels <= (uint32_t)MAX_LEVELS && entry.levels <= chain && levelBytes(entry, 0) > 0;
+}
+
+//bytes of one level as GL reads them with unpack alignment 1, 0 for a format upload() does not handle
+uint64_t TexturePack::levelBytes(const Entry& entry, int level)
+{
+	glm::ivec3 size = levelSize(entry, level);
+	uint64_t layer = 0;
+	if (isCompressed(entry))
+	{
+		//BC1 and BC4 both store a 4x4 block in 8 bytes
+		if (entry.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || entry.internalFormat == GL_COMPRESSED_RED_RGTC1 ||
+			entry.internalFormat == GL_COMPRESSED_SIGNED_RED_RGTC1)
+			layer = (uint64_t)((size.x + 3) / 4) * ((size.y + 3) / 4) * 8;
+	}
+	else
+	{
+		uint64_t channels = 0, bytes = 0;
+		switch (entry.format)
+		{
+		case GL_RED: channels = 1; break;
+		case GL_RG: channels = 2; break;
+		case GL_RGB: case GL_BGR: channels = 3; break;
+		case GL_RGBA: case GL_BGRA: channels = 4; break;
+		}
+		switch (entry.type)
+		{
+		case GL_UNSIGNED_BYTE: case GL_BYTE: bytes = 1; break;
+		case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: bytes = 2; break;
+		case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: bytes = 4; break;
+		}
+		layer = (uint64_t)size.x * size.y * channels * bytes;
+	}
+	return layer * size.z;
+}
+
+uint64_t TexturePack::totalSize(const Entry& entry)
+{
+	uint64_t total = 0;
+	for (uint32_t level = 0; level < entry.levels; level++)
+		total += entry.size[level];
+	return total;
+}
+
+void TexturePack::upload(const Entry& entry) const
+{
+	bool compressed = isCompressed(entry);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int level = 0; level < (int)entry.levels; level++)
+	{
+		glm::ivec3 size = levelSize(entry, level);
+		const unsigned char* pixels = this->levelData(entry, level);
+		GLsizei bytes = (GLsizei)entry.size[level];
+		if (entry.target == GL_TEXTURE_3D || entry.target == GL_TEXTURE_2D_ARRAY)
+		{
+			if (compressed)
+				glCompressedTexImage3D(entry.target, level, entry.internalFormat, size.x, size.y, size.z, 0, bytes, pixels);
+			else
+				glTexImage3D(entry.target, level, entry.internalFormat, size.x, size.y, size.z, 0, entry.format, entry.type, pixels);
+		}
+		else if (entry.target == GL_TEXTURE_CUBE_MAP)
+		{
+			//open() made sure the level is six whole faces
+			GLsizei faceSize = (GLsizei)(levelBytes(entry, level) / 6);
+			for (int face = 0; face < 6; face++)
+			{
+				GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+				if (compressed)
+					glCompressedTexImage2D(target, level, entry.internalFormat, size.x, size.y, 0, faceSize, pixels + face * faceSize);
+				else
+					glTexImage2D(target, level, entry.internalFormat, size.x, size.y, 0, entry.format, entry.type, pixels + face * faceSize);
+			}
+		}
+		else
+		{
+			if (compressed)
+				glCompressedTexImage2D(GL_TEXTURE_2D, level, entry.internalFormat, size.x, size.y, 0, bytes, pixels);
+			else
+				glTexImage2D(GL_TEXTURE_2D, level, entry.internalFormat, size.x, size.y, 0, entry.format, entry.type, pixels);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(entry.target, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(entry.target, GL_TEXTURE_MAX_LEVEL, entry.levels - 1);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+
+//S3TC comes from EXT_texture_compression_s3tc, which the glad loader was not generated with
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+//Read only view of a packed texture file written by TexturePacker.
+//The file is mapped, the pixels of every mip level are stored exactly as GL takes them,
+//so uploading is one glTexImage call per level straight from the mapping
+//
+//layout: Header, Entry[count], then the level data, rows tightly packed (unpack alignment 1)
+class TexturePack
+{
+public:
+	static const int MAX_LEVELS = 16;
+
+	struct Header
+	{
+		char magic[4];			//"TPAK"
+		uint32_t version;
+		uint32_t count;
+		uint32_t reserved;
+	};
+	struct Entry
+	{
+		char name[64];
+		uint32_t target;		//GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_3D or GL_TEXTURE_2D_ARRAY
+		uint32_t internalFormat;
+		uint32_t format;		//0 for block compressed levels, those go through glCompressedTexImage
+		uint32_t type;
+		uint32_t width;
+		uint32_t height;
+		uint32_t depth;			//slices of a 3D texture, layers of an array, 6 for a cube, 1 otherwise
+		uint32_t levels;
+		uint64_t offset[MAX_LEVELS];	//from the start of the file
+		uint64_t size[MAX_LEVELS];		//whole level, cube faces one after another
+	};
+	static const uint32_t VERSION = 1;
+
+	TexturePack() {}
+	TexturePack(const std::string& path) { this->open(path); }
+	~TexturePack() { this->close(); }
+	TexturePack(const TexturePack&) = delete;
+	TexturePack& operator=(const TexturePack&) = delete;
+
+	//false if the file is missing or not a pack of this version
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return this->data != nullptr; }
+
+	//NULL if there is no entry with that name
+	const Entry* find(const std::string& name) const;
+	const unsigned char* levelData(const Entry& entry, int level) const { return this->data + entry.offset[level]; }
+
+	//uploads every level of the entry to the texture bound to entry.target on the active unit
+	void upload(const Entry& entry) const;
+
+	static glm::ivec3 levelSize(const Entry& entry, int level);
+	static bool isCompressed(const Entry& entry) { return entry.format == 0; }
+	//target, dimensions, level count and format are all ones upload() handles
+	static bool isValid(const Entry& entry);
+	//bytes the GL call reads for one level, 0 if the format is not one upload() handles
+	static uint64_t levelBytes(const Entry& entry, int level);
+	//bytes of all levels, what the entry occupies on the GPU
+	static uint64_t totalSize(const Entry& entry);
+
+private:
+	const unsigned char* data = nullptr;
+	size_t length = 0;
+	const Header* header = nullptr;
+	const Entry* entries = nullptr;
+
+	//platform handles of the mapping
+	void* file = nullptr;
+	void* mapping = nullptr;
+};
@@ -0,0 +1,333 @@
+//Offline packer for the image assets: decodes every image once, builds the full mip chain
+//and writes one TexturePack file the viewer maps at startup instead of decoding PNG/JPEG.
+//
+//usage: TexturePacker [--compress] [--video] [images directory] [output file]
+//defaults are ../../Images and <images directory>/assets.pack, the viewer looks for the latter
+//--compress stores the heights as BC4 and the colour images as BC1, see BlockCompressor
+//--video also writes the wave sequence to <images directory>/waves.avi for the streamed heightmap
+
+#include <opencv2\opencv.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "TexturePack.h"
+#include "BlockCompressor.h"
+#include "Utilities/ThreadPool.h"
+
+namespace
+{
+	struct Asset
+	{
+		TexturePack::Entry entry;
+		std::vector<std::vector<unsigned char>> levels;
+	};
+
+	bool fileExists(const std::string& path)
+	{
+		FILE* fp = fopen(path.c_str(), "rb");
+		if (!fp)
+			return false;
+		fclose(fp);
+		return true;
+	}
+
+	//all images decoded in parallel, empty if one of them could not be read or sizes differ
+	std::vector<cv::Mat> decode(const std::vector<std::string>& paths, int flags)
+	{
+		std::vector<cv::Mat> images(paths.size());
+		ThreadPool::shared().parallelFor(0, (int)paths.size(), [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+				images[i] = cv::imread(paths[i], flags);
+		});
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			if (images[i].empty() || images[i].size() != images[0].size())
+			{
+				printf("TexturePacker: could not read %s or its size differs from %s\n", paths[i].c_str(), paths[0].c_str());
+				return std::vector<cv::Mat>();
+			}
+		}
+		return images;
+	}
+
+	//next mip level, every layer is box filtered and 3D stacks also average pairs of slices
+	std::vector<cv::Mat> halve(const std::vector<cv::Mat>& layers, bool shrinkDepth)
+	{
+		cv::Size size(std::max(layers[0].cols / 2, 1), std::max(layers[0].rows / 2, 1));
+		std::vector<cv::Mat> smaller(layers.size());
+		ThreadPool::shared().parallelFor(0, (int)layers.size(), [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+				cv::resize(layers[i], smaller[i], size, 0, 0, cv::INTER_AREA);
+		});
+		if (!shrinkDepth || smaller.size() == 1)
+			return smaller;
+
+		//GL rounds the depth of a level down, an odd slice left over goes into the last average
+		std::vector<cv::Mat> slices(smaller.size() / 2);
+		for (size_t i = 0; i < slices.size(); i++)
+		{
+			cv::addWeighted(smaller[2 * i], 0.5, smaller[2 * i + 1], 0.5, 0.0, slices[i]);
+			if (i + 1 == slices.size() && smaller.size() % 2 == 1)
+				cv::addWeighted(slices[i], 2.0 / 3.0, smaller[2 * i + 2], 1.0 / 3.0, 0.0, slices[i]);
+		}
+		return slices;
+	}
+
+	//one block compressed image per layer, one after another
+	std::vector<unsigned char> compress(const std::vector<cv::Mat>& layers, double& squaredError, double& samples)
+	{
+		std::vector<unsigned char> bytes;
+		for (const cv::Mat& layer : layers)
+		{
+			bool height = layer.channels() == 1;
+			std::vector<unsigned char> blocks = height ?
+				BlockCompressor::compressBC4(layer.data, layer.cols, layer.rows, layer.step[0]) :
+				BlockCompressor::compressBC1(layer.data, layer.cols, layer.rows, layer.step[0], layer.channels());
+
+			//decode again to measure what was lost
+			int blocksX = (layer.cols + 3) / 4, blocksY = (layer.rows + 3) / 4, channels = height ? 1 : 3;
+			unsigned char texels[16 * 3];
+			for (int by = 0; by < blocksY; by++)
+			{
+				for (int bx = 0; bx < blocksX; bx++)
+				{
+					const unsigned char* block = &blocks[(by * blocksX + bx) * BlockCompressor::BLOCK_BYTES];
+					if (height)
+						BlockCompressor::decodeBC4Block(block, texels);
+					else
+						BlockCompressor::decodeBC1Block(block, texels);
+					for (int i = 0; i < 16; i++)
+					{
+						int x = bx * 4 + i % 4, y = by * 4 + i / 4;
+						if (x >= layer.cols || y >= layer.rows)
+							continue;
+						const unsigned char* texel = layer.ptr<unsigned char>(y) + x * layer.channels();
+						for (int c = 0; c < channels; c++)
+						{
+							double difference = (double)texels[i * channels + c] - texel[c];
+							squaredError += difference * difference;
+							samples += 1.0;
+						}
+					}
+				}
+			}
+			bytes.insert(bytes.end(), blocks.begin(), blocks.end());
+		}
+		return bytes;
+	}
+
+	//rows tightly packed, layers one after another
+	std::vector<unsigned char> concat(const std::vector<cv::Mat>& layers)
+	{
+		std::vector<unsigned char> bytes;
+		for (const cv::Mat& layer : layers)
+		{
+			size_t row = layer.cols * layer.elemSize();
+			for (int y = 0; y < layer.rows; y++)
+				bytes.insert(bytes.end(), layer.ptr<unsigned char>(y), layer.ptr<unsigned char>(y) + row);
+		}
+		return bytes;
+	}
+
+	//compressed heights go into a 2D array, RGTC is not allowed for 3D textures
+	bool makeAsset(const char* name, GLenum target, std::vector<cv::Mat> layers, GLenum internalFormat, GLenum format, bool compressed, Asset& asset)
+	{
+		if (layers.empty())
+			return false;
+		bool height = layers[0].channels() == 1;
+		uint64_t rawSize = 0;
+		double squaredError = 0.0, samples = 0.0;
+
+		//the array keeps every frame at every level, so its chain only follows width and height
+		if (compressed && target == GL_TEXTURE_3D)
+			target = GL_TEXTURE_2D_ARRAY;
+
+		memset(&asset.entry, 0, sizeof(asset.entry));
+		strncpy(asset.entry.name, name, sizeof(asset.entry.name) - 1);
+		asset.entry.target = target;
+		asset.entry.internalFormat = compressed ? (height ? GL_COMPRESSED_RED_RGTC1 : GL_COMPRESSED_RGB_S3TC_DXT1_EXT) : internalFormat;
+		asset.entry.format = compressed ? 0 : format;
+		asset.entry.type = compressed ? 0 : GL_UNSIGNED_BYTE;
+		asset.entry.width = layers[0].cols;
+		asset.entry.height = layers[0].rows;
+		asset.entry.depth = (uint32_t)layers.size();
+
+		//down to 1x1(x1) like glGenerateMipmap
+		bool shrinkDepth = target == GL_TEXTURE_3D;
+		int largest = std::max(layers[0].cols, layers[0].rows);
+		if (shrinkDepth)
+			largest = std::max(largest, (int)layers.size());
+		int levels = 1;
+		while ((largest >> levels) > 0 && levels < TexturePack::MAX_LEVELS)
+			levels++;
+		asset.entry.levels = levels;
+
+		for (int level = 0; level < levels; level++)
+		{
+			if (level > 0)
+				layers = halve(layers, shrinkDepth);
+			std::vector<unsigned char> raw = concat(layers);
+			rawSize += raw.size();
+			if (compressed)
+				asset.levels.push_back(compress(layers, squaredError, samples));
+			else
+				asset.levels.push_back(std::move(raw));
+			asset.entry.size[level] = asset.levels.back().size();
+		}
+		printf("TexturePacker: %-12s %4ux%-4u x%-3u %2d levels", name, asset.entry.width, asset.entry.height, asset.entry.depth, levels);
+		if (compressed)
+			printf(", %s %.2f MB -> %s %.2f MB, rms error %.2f", height ? "R8" : "RGB8", rawSize / (1024.0 * 1024.0),
+				height ? "BC4" : "BC1", TexturePack::totalSize(asset.entry) / (1024.0 * 1024.0), std::sqrt(squaredError / std::max(samples, 1.0)));
+		else
+			printf(", %.2f MB", rawSize / (1024.0 * 1024.0));
+		printf("\n");
+		return true;
+	}
+
+	//the sequence as one grayscale video for VideoHeightmapStream, one frame per image
+	bool writeVideo(const std::string& path, const std::vector<cv::Mat>& frames)
+	{
+		if (frames.empty())
+			return false;
+		cv::VideoWriter writer(path, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 50.0, frames[0].size(), false);
+		if (!writer.isOpened())
+		{
+			printf("TexturePacker: could not write %s\n", path.c_str());
+			return false;
+		}
+		for (const cv::Mat& frame : frames)
+			writer.write(frame);
+		writer.release();
+
+		FILE* file = fopen(path.c_str(), "rb");
+		long size = 0;
+		if (file)
+		{
+			fseek(file, 0, SEEK_END);
+			size = ftell(file);
+			fclose(file);
+		}
+		printf("TexturePacker: wrote %s, %zu frames, %.1f MB\n", path.c_str(), frames.size(), size / (1024.0 * 1024.0));
+		return true;
+	}
+
+	bool write(const std::string& path, std::vector<Asset>& assets)
+	{
+		TexturePack::Header header;
+		memcpy(header.magic, "TPAK", 4);
+		header.version = TexturePack::VERSION;
+		header.count = (uint32_t)assets.size();
+		header.reserved = 0;
+
+		//levels start 16 byte aligned after the entry table
+		uint64_t offset = sizeof(TexturePack::Header) + assets.size() * sizeof(TexturePack::Entry);
+		for (Asset& asset : assets)
+		{
+			for (uint32_t level = 0; level < asset.entry.levels; level++)
+			{
+				offset = (offset + 15) & ~(uint64_t)15;
+				asset.entry.offset[level] = offset;
+				offset += asset.entry.size[level];
+			}
+		}
+
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			printf("TexturePacker: could not write %s\n", path.c_str());
+			return false;
+		}
+		const unsigned char zeros[16] = {};
+		fwrite(&header, sizeof(header), 1, file);
+		for (const Asset& asset : assets)
+			fwrite(&asset.entry, sizeof(asset.entry), 1, file);
+		uint64_t written = sizeof(TexturePack::Header) + assets.size() * sizeof(TexturePack::Entry);
+		for (const Asset& asset : assets)
+		{
+			for (uint32_t level = 0; level < asset.entry.levels; level++)
+			{
+				fwrite(zeros, 1, (size_t)(asset.entry.offset[level] - written), file);
+				fwrite(asset.levels[level].data(), 1, asset.levels[level].size(), file);
+				written = asset.entry.offset[level] + asset.entry.size[level];
+			}
+		}
+		bool ok = ferror(file) == 0;
+		fclose(file);
+		printf("TexturePacker: wrote %s, %.1f MB\n", path.c_str(), written / (1024.0 * 1024.0));
+		return ok;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool compressed = false, video = false;
+	while (argc > 1 && strncmp(argv[1], "--", 2) == 0)
+	{
+		compressed |= strcmp(argv[1], "--compress") == 0;
+		video |= strcmp(argv[1], "--video") == 0;
+		argc--;
+		argv++;
+	}
+	std::string images = (argc > 1) ? argv[1] : "../../Images";
+	std::string output = (argc > 2) ? argv[2] : images + "/assets.pack";
+
+	std::vector<Asset> assets;
+	Asset asset;
+
+	//same sequence the viewer loads, 000.png upwards until the first gap
+	std::vector<std::string> waves;
+	for (int i = 0;; i++)
+	{
+		std::stringstream ss;
+		ss << images << "/waves/" << std::setw(3) << std::setfill('0') << i << ".png";
+		if (!fileExists(ss.str()))
+			break;
+		waves.push_back(ss.str());
+	}
+	std::vector<cv::Mat> heights = decode(waves, cv::IMREAD_GRAYSCALE);
+	if (video && !writeVideo(images + "/waves.avi", heights))
+		return 1;
+	if (makeAsset("waves", GL_TEXTURE_3D, heights, GL_R8, GL_RED, compressed, asset))
+		assets.push_back(asset);
+
+	const char* pictures[2] = { "tiles.jpg", "church.png" };
+	for (const char* picture : pictures)
+	{
+		asset = Asset();
+		if (makeAsset(picture, GL_TEXTURE_2D, decode({ images + "/" + picture }, cv::IMREAD_COLOR), GL_RGB8, GL_BGR, compressed, asset))
+			assets.push_back(asset);
+	}
+
+	//GL face order, matches the paths in TrainView
+	const char* faces[6] = { "right.jpg", "left.jpg", "top.jpg", "bottom.jpg", "back.jpg", "front.jpg" };
+	std::vector<std::string> skybox;
+	for (const char* face : faces)
+		skybox.push_back(images + "/skybox/" + face);
+	asset = Asset();
+	if (makeAsset("skybox", GL_TEXTURE_CUBE_MAP, decode(skybox, cv::IMREAD_COLOR), GL_RGB8, GL_BGR, compressed, asset))
+		assets.push_back(asset);
+
+	if (assets.empty() || !write(output, assets))
+		return 1;
+
+	//read it back the way the viewer does
+	TexturePack pack(output);
+	for (const Asset& packed : assets)
+	{
+		if (!pack.find(packed.entry.name))
+		{
+			printf("TexturePacker: %s is missing from %s\n", packed.entry.name, output.c_str());
+			return 1;
+		}
+	}
+	return 0;
+}
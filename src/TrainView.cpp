@@ -46,6 +46,87 @@
 #	include "TrainExample/TrainExample.H"
 #endif
 
+namespace
+{
+	//ShaderVariants keys, the shading ones in getShadingSelect() order
+	const std::vector<std::string> shadingKeys = { "SHADING_NONE", "SHADING_PHONG", "SHADING_GOURAUD", "SHADING_TOON" };
+	const std::vector<std::string> waveKeys = { "WAVE_SINE", "WAVE_HEIGHTMAP", "WAVE_OCEAN", "WAVE_RIPPLES",
+		"WAVE_RIPPLE_LUT", "WAVE_SOLVER", "WAVE_GERSTNER", "WAVE_BAKED" };
+	const std::vector<std::string> effectKeys = { "EFFECT_PIXELATE", "EFFECT_OFFSET", "EFFECT_ROTATE" };
+
+	//the per frame uniforms, Shader::handles() resolves them once for every program and variant
+	struct ObjectUniforms
+	{
+		Shader::Uniform<int> shadingSelect, texture, useTexture;
+		Shader::Uniform<glm::vec3> viewerPos;
+		ObjectUniforms(Shader* shader)
+		{
+			this->shadingSelect = shader->uniform<int>("u_shadingSelect");
+			this->texture = shader->uniform<int>("u_texture");
+			this->useTexture = shader->uniform<int>("u_useTexture");
+			this->viewerPos = shader->uniform<glm::vec3>("u_viewer_pos");
+		}
+	};
+	//read by waveFunctions.glsl, shared by the surface, the bake and the readback pass
+	struct WaveUniforms
+	{
+		Shader::Uniform<glm::vec2> direction, rippleLutRange;
+		Shader::Uniform<float> time, wavelength, amplitude, heightmapFrames, heightmapRate;
+		Shader::Uniform<int> waveSelect, useOcean, simSelect, heightmap, heightmapLayers, heightmapArray;
+		Shader::Uniform<int> heightmapSlope, useHeightmapSlope, simMap, oceanMap, dropGridSize, useRippleLut, rippleLut;
+		WaveUniforms(Shader* shader)
+		{
+			this->direction = shader->uniform<glm::vec2>("u_direction");
+			this->time = shader->uniform<float>("u_time");
+			this->wavelength = shader->uniform<float>("u_wavelength");
+			this->amplitude = shader->uniform<float>("u_amplitude");
+			this->waveSelect = shader->uniform<int>("u_waveSelect");
+			this->useOcean = shader->uniform<int>("u_useOcean");
+			this->simSelect = shader->uniform<int>("u_simSelect");
+			this->heightmap = shader->uniform<int>("u_heightmap");
+			this->heightmapLayers = shader->uniform<int>("u_heightmapLayers");
+			this->heightmapArray = shader->uniform<int>("u_heightmapArray");
+			this->heightmapFrames = shader->uniform<float>("u_heightmapFrames");
+			this->heightmapRate = shader->uniform<float>("u_heightmapRate");
+			this->heightmapSlope = shader->uniform<int>("u_heightmapSlope");
+			this->useHeightmapSlope = shader->uniform<int>("u_useHeightmapSlope");
+			this->simMap = shader->uniform<int>("u_simMap");
+			this->oceanMap = shader->uniform<int>("u_oceanMap");
+			this->dropGridSize = shader->uniform<int>("u_dropGridSize");
+			this->useRippleLut = shader->uniform<int>("u_useRippleLut");
+			this->rippleLut = shader->uniform<int>("u_rippleLut");
+			this->rippleLutRange = shader->uniform<glm::vec2>("u_rippleLutRange");
+		}
+	};
+	struct SurfaceUniforms
+	{
+		Shader::Uniform<int> shadingSelect, realTimeRender, useBake, adaptiveTess, bakeDisplacement, bakeNormal;
+		Shader::Uniform<int> skybox, refractTexture, reflectTexture, useTexture;
+		Shader::Uniform<float> fixedTessLevel, viewportHeight, tessPixels, tessFlatScale, tessSteepSlope;
+		Shader::Uniform<glm::vec3> viewerPos, waveBound;
+		SurfaceUniforms(Shader* shader)
+		{
+			this->shadingSelect = shader->uniform<int>("u_shadingSelect");
+			this->viewerPos = shader->uniform<glm::vec3>("u_viewer_pos");
+			this->realTimeRender = shader->uniform<int>("u_realTimeRender");
+			this->useBake = shader->uniform<int>("u_useBake");
+			this->fixedTessLevel = shader->uniform<float>("u_fixedTessLevel");
+			this->adaptiveTess = shader->uniform<int>("u_adaptiveTess");
+			this->viewportHeight = shader->uniform<float>("u_viewportHeight");
+			this->tessPixels = shader->uniform<float>("u_tessPixels");
+			this->tessFlatScale = shader->uniform<float>("u_tessFlatScale");
+			this->tessSteepSlope = shader->uniform<float>("u_tessSteepSlope");
+			this->waveBound = shader->uniform<glm::vec3>("u_waveBound");
+			this->bakeDisplacement = shader->uniform<int>("u_bakeDisplacement");
+			this->bakeNormal = shader->uniform<int>("u_bakeNormal");
+			this->skybox = shader->uniform<int>("u_skybox");
+			this->refractTexture = shader->uniform<int>("u_refractTexture");
+			this->reflectTexture = shader->uniform<int>("u_reflectTexture");
+			this->useTexture = shader->uniform<int>("u_useTexture");
+		}
+	};
+}
+
 
 //************************************************************************
 //
@@ -59,6 +140,40 @@ TrainView(int x, int y, int w, int h, const char* l)
 	mode(FL_RGB | FL_ALPHA | FL_DOUBLE | FL_STENCIL);
 
 	resetArcball();
+
+	this->waveSolver = new WaveSolver(256);
+	this->gpuWaveSolver = new GpuWaveSolver(256);
+	this->ocean = new OceanFFT(OceanFFT::Settings());
+	this->waveSet = new WaveSet();
+	this->surfaceBaker = new SurfaceBaker();
+	this->heightReadback = new HeightReadback(3);
+	this->dropBins = new DropBins(16);
+	this->rippleLut = new RippleLut();
+
+	this->waveField = new WaveField();
+	this->waveField->drops = &this->drops;
+	this->waveField->dropBins = this->dropBins;
+	this->waveField->waveSet = this->waveSet;
+	this->picker.waterHeight = [this](const glm::vec2& position) { return this->waveField->height(position); };
+
+	//a sun, the light box and a flashlight at the eye
+	LightSet::Directional sun;
+	sun.direction = glm::vec3(0.0f, -1.0f, -1.0f);
+	this->lights.directional.push_back(sun);
+	LightSet::Point lamp;
+	lamp.position = this->lightBoxPos;
+	lamp.linear = 0.01f;
+	lamp.quadratic = 0.0001f;
+	this->lights.points.push_back(lamp);
+	this->lights.spots.push_back(LightSet::Spot());
+
+	this->mainClusters = new LightClusters();
+	//the far plane of the arcball's projection, the reflection passes stop at Camera::passFar
+	this->mainClusters->zFar = 3000.0f;
+	this->reflectClusters = new LightClusters();
+	this->reflectClusters->name = "Light clusters (reflect)";
+	this->refractClusters = new LightClusters();
+	this->refractClusters->name = "Light clusters (refract)";
 }
 
 //************************************************************************
@@ -122,7 +237,8 @@ int TrainView::handle(int event)
 			ControlPoint* cp = &m_pTrack->points[selectedCube];
 
 			double r1x, r1y, r1z, r2x, r2y, r2z;
-			getMouseLine(r1x, r1y, r1z, r2x, r2y, r2z);
+			getMouseLine(this->camera.main.view, this->camera.main.projection, w(), h(),
+				r1x, r1y, r1z, r2x, r2y, r2z);
 
 			double rx, ry, rz;
 			mousePoleGo(r1x, r1y, r1z, r2x, r2y, r2z,
@@ -137,6 +253,14 @@ int TrainView::handle(int event)
 			cp->pos.z = (float)rz;
 			damage(1);
 		}
+		// paint drops along the drag, the pick runs on the CPU so every event gets one
+		else if (last_push == FL_LEFT_MOUSE && this->tw->waveBrowser->selected(3)) {
+			Picker::Hit hit = this->pickUnderMouse();
+			if (hit.kind == Picker::Water)
+				this->addDrop(hit.uv);
+			damage(1);
+			return 1;
+		}
 		break;
 
 		// in order to get keyboard events, we need to accept focus
@@ -151,6 +275,12 @@ int TrainView::handle(int event)
 	case FL_KEYBOARD:
 		int k = Fl::event_key();
 		int ks = Fl::event_state();
+		if (k >= '1' && k <= '3') {
+			// 100, 1000 or 10000 drops at once
+			this->addRandomDrops(k == '1' ? 100 : (k == '2' ? 1000 : 10000));
+			damage(1);
+			return 1;
+		}
 		if (k == 'p') {
 			// Print out the selected control point information
 			if (selectedCube >= 0)
@@ -204,11 +334,14 @@ void TrainView::draw()
 
 		if (!this->simpleShader)
 		{
-			this->simpleShader = new
-				Shader(
-					"../../src/shaders/simple.vert",
-					nullptr, nullptr, nullptr,
-					"../../src/shaders/simple.frag");
+			this->shaderStart = std::chrono::high_resolution_clock::now();
+			this->shadersPending = true;
+			this->simpleVariants = new ShaderVariants("Objects",
+				"../../src/shaders/simple.vert",
+				nullptr, nullptr, nullptr,
+				"../../src/shaders/simple.frag",
+				shadingKeys);
+			this->simpleShader = this->simpleVariants->getGeneric();
 		}
 		if (!this->backgroundShader)
 		{
@@ -220,29 +353,27 @@ void TrainView::draw()
 		}
 		if (!this->surfaceShader)
 		{
-			this->surfaceShader = new
-				Shader(
-					"../../src/shaders/forSurface.vert",
-					"../../src/shaders/forSurface.tesc",
-					"../../src/shaders/forSurface.tese",
-					nullptr,
-					"../../src/shaders/forSurface.frag");
-		}
-
-		if (!this->pickShader)
-		{
-			this->pickShader = new Shader(
-				"../../src/shaders/pickSurface.vert",
-				nullptr, nullptr, nullptr,
-				"../../src/shaders/pickSurface.frag");
+			std::vector<std::string> keys = waveKeys;
+			keys.insert(keys.end(), shadingKeys.begin(), shadingKeys.end());
+			keys.push_back("REALTIME_RENDER");
+			this->surfaceVariants = new ShaderVariants("Surface",
+				"../../src/shaders/forSurface.vert",
+				"../../src/shaders/forSurface.tesc",
+				"../../src/shaders/forSurface.tese",
+				nullptr,
+				"../../src/shaders/forSurface.frag",
+				keys);
+			this->surfaceShader = this->surfaceVariants->getGeneric();
 		}
 
 		if (!this->postProcessShader)
 		{
-			this->postProcessShader = new Shader(
+			this->postProcessVariants = new ShaderVariants("Post process",
 				"../../src/shaders/postProcess.vert",
 				nullptr, nullptr, nullptr,
-				"../../src/shaders/postProcess.frag");
+				"../../src/shaders/postProcess.frag",
+				effectKeys);
+			this->postProcessShader = this->postProcessVariants->getGeneric();
 		}
 
 		if (!this->commom_matrices)
@@ -310,16 +441,6 @@ void TrainView::draw()
 			glBindTexture(GL_TEXTURE_2D, 0);
 
 
-			glGenFramebuffers(1, &this->pickSurfaceBuffer);
-			glGenRenderbuffers(1, &this->pickSurfaceRenderBuffer);
-			glBindFramebuffer(GL_FRAMEBUFFER, this->pickSurfaceBuffer);
-			glBindRenderbuffer(GL_RENDERBUFFER, this->pickSurfaceRenderBuffer);
-			glRenderbufferStorage(GL_RENDERBUFFER, GL_RGB8, this->pixel_w(), this->pixel_h());
-			glBindRenderbuffer(GL_RENDERBUFFER, 0);
-			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->pickSurfaceRenderBuffer);
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-
 			glGenTextures(1, &frameTexture);
 			glBindTexture(GL_TEXTURE_2D, frameTexture);
 			glGenFramebuffers(1, &this->frameFBO);
@@ -344,12 +465,24 @@ void TrainView::draw()
 		}
 
 
+		//run TexturePacker to make the pack, the images are decoded when it is missing
+		TexturePack assets;
+		if (!this->texture || !this->tile || !this->background)
+			assets.open("../../Images/assets.pack");
+
 		if (!this->texture)
-			this->texture = new Texture2D("../../Images/church.png");
+		{
+			if (assets.find("church.png"))
+				this->texture = new Texture2D(assets, "church.png");
+			else
+				this->texture = Texture2D::loadAsync("../../Images/church.png");
+		}
 
-		if (this->heightmap.empty())
+		if (this->heightmapPaths.empty())
 		{
-			for (int i = 0; i < 200; i++)
+			std::vector<std::string>& paths = this->heightmapPaths;
+			//000.png upwards until the first gap, WaveBaker can write longer sequences
+			for (int i = 0;; i++)
 			{
 				std::stringstream ss;
 				ss << std::setw(3) << std::setfill('0') << i;
@@ -357,7 +490,7 @@ void TrainView::draw()
 				std::string str = "../../Images/waves/" + cnt + ".png";
 				if (fileExists(str))
 				{
-					this->heightmap.push_back(new Texture2D((str.c_str())));
+					paths.push_back(str);
 				}
 				else
 				{
@@ -367,7 +500,21 @@ void TrainView::draw()
 		}
 
 		if (!this->tile)
-			this->tile = new Texture2D("../../Images/tiles.jpg");
+		{
+			if (assets.find("tiles.jpg"))
+				this->tile = new Texture2D(assets, "tiles.jpg");
+			else
+				this->tile = Texture2D::loadAsync("../../Images/tiles.jpg");
+		}
+
+		if (!this->simMap)
+		{
+			int res = this->waveSolver->getResolution();
+			this->simMap = new Texture2D(res, res, GL_RGBA32F, GL_RGBA, GL_FLOAT);
+		}
+
+		if (!this->background && assets.find("skybox"))
+			this->background = new TextureCube(assets, "skybox");
 
 		if (!this->background)
 		{
@@ -380,7 +527,7 @@ void TrainView::draw()
 				"../../Images/skybox/back.jpg",
 				"../../Images/skybox/front.jpg"
 			};
-			this->background = new TextureCube(paths);
+			this->background = TextureCube::loadAsync(paths);
 		}
 
 		//if (!this->device) {
@@ -445,6 +592,19 @@ void TrainView::draw()
 	else
 		throw std::runtime_error("Could not initialize GLAD!");
 
+	//upload whatever the loader threads finished since the last frame
+	ImageLoader::shared().pump();
+
+	//programs still compiling on the driver's threads, show the background colour until they are done
+	if (!this->shadersReady())
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, w(), h());
+		glClearColor(0, 0, .3f, 0);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		return;
+	}
+
 	glBindFramebuffer(GL_FRAMEBUFFER, this->frameFBO);
 	// Set up the view port
 	glViewport(0, 0, w(), h());
@@ -564,166 +724,60 @@ void TrainView::draw()
 	glBindBufferRange(
 		GL_UNIFORM_BUFFER, /*binding point*/0, this->commom_matrices->ubo, 0, this->commom_matrices->size);
 
-	this->drawBackground();
+	this->drawBackground(this->camera.main.view, this->camera.main.skyProjection);
 
 	//bind shader
+	this->simpleVariants->update();
+	this->surfaceVariants->update();
+	this->postProcessVariants->update();
+	this->simpleShader = this->simpleVariants->get(this->simpleVariants->bit(shadingKeys[this->getShadingSelect()]));
 	this->simpleShader->Use();
 #pragma region simpleShaderLight
 
 	//Lighting------------------------------------------------
 
 
-	if (this->tw->shadingBrowser->selected(2))
-	{
-		this->simpleShader->setInt("u_shadingSelect", 1); //0-No 1-Phong 2-Garudond
-	}
-	else if (this->tw->shadingBrowser->selected(3))
-	{
-		this->simpleShader->setInt("u_shadingSelect", 2); //0-No 1-Phong 2-Garudond
-	}
-	else if (this->tw->shadingBrowser->selected(4))
-	{
-		this->simpleShader->setInt("u_shadingSelect", 3); //0-No 1-Phong 2-Garudond 3-Toon
-	}
-	else
-	{
-		this->simpleShader->setInt("u_shadingSelect", 0); //0-No 1-Phong 2-Garudond	
-	}
-	this->simpleShader->setVec3("u_viewer_pos", this->arcball.getEyePos());
-
-	this->simpleShader->setVec3("dirLights[0].direction", 0.0f, -1.0f, -1.0f);
-	this->simpleShader->setVec3("dirLights[0].ambient", 0.2f, 0.2f, 0.2f);
-	this->simpleShader->setVec3("dirLights[0].diffuse", 1.0f, 1.0f, 1.0f);
-	this->simpleShader->setVec3("dirLights[0].specular", 1.0f, 1.0f, 1.0f);
-
-	this->simpleShader->setVec3("pointLights[0].position", this->lightBoxPos);
-	this->simpleShader->setVec3("pointLights[0].ambient", 0.2f, 0.2f, 0.2f);
-	this->simpleShader->setVec3("pointLights[0].diffuse", 1.0f, 1.0f, 1.0f);
-	this->simpleShader->setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-	this->simpleShader->setFloat("pointLights[0].constant", 1.0f);
-	this->simpleShader->setFloat("pointLights[0].linear", 0.01f);
-	this->simpleShader->setFloat("pointLights[0].quadratic", 0.0001f);
-
-	this->simpleShader->setVec3("spotLights[0].position", this->arcball.getEyePos());
-	this->simpleShader->setVec3("spotLights[0].ambient", 0.2f, 0.2f, 0.2f);
-	this->simpleShader->setVec3("spotLights[0].diffuse", 1.0f, 1.0f, 1.0f);
-	this->simpleShader->setVec3("spotLights[0].specular", 1.0f, 1.0f, 1.0f);
-	this->simpleShader->setFloat("spotLights[0].constant", 1.0f);
-	this->simpleShader->setFloat("spotLights[0].linear", 0);
-	this->simpleShader->setFloat("spotLights[0].quadratic", 0);
-	this->simpleShader->setVec3("spotLights[0].direction", -this->arcball.getEyePos());
-	this->simpleShader->setFloat("spotLights[0].cutoff", glm::cos(glm::radians(10.0f)));
-	this->simpleShader->setFloat("spotLights[0].outer_cutoff", glm::cos(glm::radians(15.0f)));
+	const ObjectUniforms& objectUniforms = this->simpleShader->handles<ObjectUniforms>();
+	this->simpleShader->set(objectUniforms.shadingSelect, this->getShadingSelect()); //0-No 1-Phong 2-Garudond 3-Toon
+	this->simpleShader->set(objectUniforms.viewerPos, this->camera.eye);
+
+	//one block for every lit program, the light box and the flashlight move
+	this->lights.points[0].position = this->lightBoxPos;
+	this->lights.spots[0].position = this->camera.eye;
+	this->lights.spots[0].direction = -this->camera.eye;
+	this->updateLamps();
+	this->lights.bind();
+
+	this->mainClusters->build(this->lights, this->camera.main.view, this->camera.main.projection);
+	this->mainClusters->bind();
 
 	//Lighting------------------------------------------------
 #pragma endregion
 
 
+	this->simpleVariants->timer().begin();
 	this->simpleShaderDraw(false);
-
-	if (true)
+	this->simpleVariants->timer().end();
+
+	//the reflection and refraction passes, their matrices come from the camera
+	const Camera::Pass* passes[2] = { &this->camera.reflect, &this->camera.refract };
+	GLuint passFBOs[2] = { this->reflectFBO, this->refractFBO };
+	LightClusters* passClusters[2] = { this->reflectClusters, this->refractClusters };
+	//the mirrored scene turns inside out
+	bool reverse[2] = { true, false };
+	for (int i = 0; i < 2; i++)
 	{
-		glm::vec3 p0 = glm::vec3(-200, 0, 200);
-		glm::vec3 n = glm::vec3(0, 1, 0);
-
-		float mA = n.x;
-		float mB = n.y;
-		float mC = n.z;
-		float mD = -n.x*p0.x - n.y*p0.y - n.z*p0.z;;
-		glm::mat4 reflectMat;
-		reflectMat[0][0] = -2 * n.x*n.x + 1;
-		reflectMat[0][1] = -2 * n.x * n.y;
-		reflectMat[0][2] = -2 * n.x * n.z;
-		reflectMat[0][3] = -2 * n.x * mD;
-
-		reflectMat[1][0] = -2 * n.x * n.y;
-		reflectMat[1][1] = -2 * n.y * n.y + 1;
-		reflectMat[1][2] = -2 * n.y * n.z;
-		reflectMat[1][3] = -2 * n.y * mD;
-
-		reflectMat[2][0] = -2 * n.z * n.x;
-		reflectMat[2][1] = -2 * n.z * n.y;
-		reflectMat[2][2] = -2 * n.z * n.z + 1;
-		reflectMat[2][3] = -2 * n.z * mD;
-
-		reflectMat[3][0] = 0;
-		reflectMat[3][1] = 0;
-		reflectMat[3][2] = 0;
-		reflectMat[3][3] = 1;
-
-
-		glm::mat4 viewMat;
-		glGetFloatv(GL_MODELVIEW_MATRIX, &viewMat[0][0]);
-		glm::mat4 viewPrime = viewMat * reflectMat;
-		glm::mat4 projection_matrix;
-		glGetFloatv(GL_PROJECTION_MATRIX, &projection_matrix[0][0]);
-		float fov = 2.0*atan(1.0 / projection_matrix[1][1]) * 180.0 / 3.1415926;
-		projection_matrix = glm::perspective<float>(glm::radians(fov), 1.0f, 0.01, 1000.0f);
-		glm::mat4 _projection_matrix = projection_matrix;
-		glm::vec4 newClipPlane = glm::transpose(glm::inverse(viewPrime))*glm::vec4(n, mD);
-		glm::vec4 q = glm::vec4((glm::sign(newClipPlane.x) + _projection_matrix[2][0]) / _projection_matrix[0][0],
-			(glm::sign(newClipPlane.y) + _projection_matrix[2][1]) / _projection_matrix[1][1],
-			-1.0f, (1.0f + _projection_matrix[2][2]) / _projection_matrix[3][2]);
-		glm::vec4 c = newClipPlane * (2.0f / glm::dot(newClipPlane, q));
-		_projection_matrix[0][2] = c.x;
-		_projection_matrix[1][2] = c.y;
-		_projection_matrix[2][2] = c.z + 1.0f;
-		_projection_matrix[3][2] = c.w;
-
-
-
-
-		glBindFramebuffer(GL_FRAMEBUFFER, reflectFBO);
+		const Camera::Pass& pass = *passes[i];
+		glBindFramebuffer(GL_FRAMEBUFFER, passFBOs[i]);
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		setViewAndProjToUBO(pass.view, pass.projection);
+		passClusters[i]->build(this->lights, pass.view, pass.projection);
+		passClusters[i]->bind();
+		this->drawBackground(pass.view, pass.skyProjection);
 		this->simpleShader->Use();
-
-		setViewAndProjToUBO(viewPrime, _projection_matrix);
-		this->drawBackground(viewPrime, projection_matrix);
-		this->simpleShader->Use();
-		this->simpleShaderDraw(true);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	}
-
-	if (true)
-	{
-		glm::vec3 campos = this->arcball.getEyePos();
-		float len = sqrt(campos.x*campos.x + campos.y*campos.y + campos.z*campos.z);
-
-		glm::vec3 p0 = glm::vec3(-200, 0, 200);
-		glm::vec3 n = glm::vec3(0, 1, 0);
-
-		float mA = n.x;
-		float mB = n.y;
-		float mC = n.z;
-		float mD = -n.x*p0.x - n.y*p0.y - n.z*p0.z;;
-
-		glm::mat4 viewMat;
-		glGetFloatv(GL_MODELVIEW_MATRIX, &viewMat[0][0]);
-		glm::mat4 viewPrime = viewMat * glm::scale(glm::vec3(1, glm::clamp(1.0f - (0.3f), 0.001f, 1.0f), 1));
-		glm::mat4 projection_matrix;
-		glGetFloatv(GL_PROJECTION_MATRIX, &projection_matrix[0][0]);
-		float fov = 2.0*atan(1.0 / projection_matrix[1][1]) * 180.0 / 3.1415926;
-		projection_matrix = glm::perspective<float>(glm::radians(fov), 1.0f, 0.01, 1000.0f);
-		
-		glm::vec4 newClipPlane = glm::transpose(glm::inverse(viewPrime))*glm::vec4(n, mD);
-		glm::mat4 _projection_matrix = projection_matrix;
-		(&_projection_matrix[0][0])[2] = newClipPlane.x + (&_projection_matrix[0][0])[3];//x
-        (&_projection_matrix[0][0])[6] = newClipPlane.y + (&_projection_matrix[0][0])[7];//y
-        (&_projection_matrix[0][0])[10] = newClipPlane.z + (&_projection_matrix[0][0])[11];//z
-        (&_projection_matrix[0][0])[14] = newClipPlane.w + (&_projection_matrix[0][0])[15];//w
-
-		glBindFramebuffer(GL_FRAMEBUFFER, refractFBO);
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		this->simpleShader->Use();
-
-		setViewAndProjToUBO(viewPrime, _projection_matrix);
-		this->drawBackground(viewPrime, projection_matrix);
-		this->simpleShader->Use();
-		this->simpleShaderDraw(false);
+		this->simpleShaderDraw(reverse[i]);
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
@@ -735,6 +789,7 @@ void TrainView::draw()
 	setViewAndProjToUBO();
 	glBindBufferRange(
 		GL_UNIFORM_BUFFER, /*binding point*/0, this->commom_matrices->ubo, 0, this->commom_matrices->size);
+	this->mainClusters->bind();
 	glActiveTexture(GL_TEXTURE11);
 	glBindTexture(GL_TEXTURE_2D, this->refractTexture);
 
@@ -757,11 +812,6 @@ void TrainView::draw()
 	// it for shadows
 	glClearStencil(0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-	this->postProcessShader->Use();
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, this->frameTexture);
-	this->postProcessShader->setInt("u_frame", 0);
-	this->postProcessShader->setFloat("u_time", this->m_pTrack->trainU);
 	GLuint effects = 0;
 	if (this->tw->pixelation->value())
 	{
@@ -775,16 +825,58 @@ void TrainView::draw()
 	{
 		effects |= 0x04;
 	}
+	//the effect bits are the key bits
+	this->postProcessShader = this->postProcessVariants->get(effects);
+	this->postProcessShader->Use();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, this->frameTexture);
+	this->postProcessShader->setInt("u_frame", 0);
+	this->postProcessShader->setFloat("u_time", this->m_pTrack->trainU);
 	this->postProcessShader->setInt("u_effect", effects);
 	if (true)
 	{
+		this->postProcessVariants->timer().begin();
 		this->bgPlane.draw(this->postProcessShader, glm::mat4());
-
+		this->postProcessVariants->timer().end();
 	}
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, 0);
 	glUseProgram(0);
 
+	Shader::reportUniforms();
+	//one time per variant, the surface ones with and without WAVE_BAKED are what to compare
+	//when switching the bake on and off
+	this->simpleVariants->report();
+	this->surfaceVariants->report();
+	this->postProcessVariants->report();
+	this->mainClusters->report();
+	this->picker.report();
+	this->reflectClusters->report();
+	this->refractClusters->report();
+	this->lutTimer.report();
+	this->transcendentalTimer.report();
+	if (this->tw->tessBench->value())
+	{
+		this->adaptiveTessTimer.report();
+		this->distanceTessTimer.report();
+		this->adaptiveTessPrimitives.report();
+		this->distanceTessPrimitives.report();
+	}
+	if (this->tw->bake->value())
+		this->surfaceBaker->timer.report();
+	if (this->waveField->needsReadback())
+		this->heightReadback->report();
+	if (this->useGpuSolver())
+		this->gpuWaveSolver->timer.report();
+	else if (this->useOcean())
+		this->ocean->report();
+	if (this->getWaveSelect() == 1 && !this->useOcean())
+	{
+		if (this->heightmapStream)
+			this->heightmapStream->report();
+		if (this->heightmapVideo)
+			this->heightmapVideo->report();
+	}
 }
 
 void TrainView::simpleShaderDraw(bool reverse)
@@ -794,8 +886,9 @@ void TrainView::simpleShaderDraw(bool reverse)
 	model_matrix = glm::translate(model_matrix, this->source_pos);
 	model_matrix = glm::scale(model_matrix, glm::vec3(10.0f, 10.0f, 10.0f));
 
+	const ObjectUniforms& uniforms = this->simpleShader->handles<ObjectUniforms>();
 	this->texture->bind(0);
-	glUniform1i(glGetUniformLocation(this->simpleShader->Program, "u_texture"), 0);
+	this->simpleShader->set(uniforms.texture, 0);
 	setUseTexture(false);
 
 	//this->plane.draw(this->simpleShader, model_matrix);
@@ -850,10 +943,10 @@ void TrainView::simpleShaderDraw(bool reverse)
 
 		model_matrix = glm::rotate(model_matrix, glm::radians(90.0f), glm::vec3(1, 0, 0));;
 		model_matrix = glm::rotate(model_matrix, glm::radians(90.0f), glm::vec3(0, 1, 0));;
-		glUniformMatrix4fv(glGetUniformLocation(this->simpleShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
+		this->simpleShader->setModel(model_matrix);
 
 		this->tile->bind(0);
-		glUniform1i(glGetUniformLocation(this->simpleShader->Program, "u_texture"), 0);
+		this->simpleShader->set(uniforms.texture, 0);
 		setUseTexture(true);
 
 		this->plane.draw(this->simpleShader, model_matrix);
@@ -865,7 +958,7 @@ void TrainView::simpleShaderDraw(bool reverse)
 		model_matrix = glm::rotate(model_matrix, glm::radians(180.0f), glm::vec3(0, 1, 0));;
 		model_matrix = glm::rotate(model_matrix, glm::radians(90.0f), glm::vec3(1, 0, 0));;
 		model_matrix = glm::rotate(model_matrix, glm::radians(90.0f), glm::vec3(0, 1, 0));;
-		glUniformMatrix4fv(glGetUniformLocation(this->simpleShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
+		this->simpleShader->setModel(model_matrix);
 
 		this->plane.draw(this->simpleShader, model_matrix);
 
@@ -876,7 +969,7 @@ void TrainView::simpleShaderDraw(bool reverse)
 		model_matrix = glm::rotate(model_matrix, glm::radians(90.0f), glm::vec3(0, 1, 0));;
 		model_matrix = glm::rotate(model_matrix, glm::radians(90.0f), glm::vec3(1, 0, 0));;
 		model_matrix = glm::rotate(model_matrix, glm::radians(90.0f), glm::vec3(0, 1, 0));;
-		glUniformMatrix4fv(glGetUniformLocation(this->simpleShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
+		this->simpleShader->setModel(model_matrix);
 
 
 
@@ -889,7 +982,7 @@ void TrainView::simpleShaderDraw(bool reverse)
 		model_matrix = glm::rotate(model_matrix, glm::radians(90.0f), glm::vec3(0, 1, 0));;
 		model_matrix = glm::rotate(model_matrix, glm::radians(-90.0f), glm::vec3(1, 0, 0));;
 		model_matrix = glm::rotate(model_matrix, glm::radians(-90.0f), glm::vec3(0, 1, 0));;
-		glUniformMatrix4fv(glGetUniformLocation(this->simpleShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
+		this->simpleShader->setModel(model_matrix);
 
 		this->plane.draw(this->simpleShader, model_matrix);
 
@@ -897,7 +990,7 @@ void TrainView::simpleShaderDraw(bool reverse)
 		model_matrix = glm::scale(model_matrix, glm::vec3(200.0f, 1.0f, 200.0f));
 		model_matrix = glm::translate(model_matrix, glm::vec3(0, -50, 0));
 
-		glUniformMatrix4fv(glGetUniformLocation(this->simpleShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
+		this->simpleShader->setModel(model_matrix);
 
 		this->plane.draw(this->simpleShader, model_matrix);
 		this->tile->unbind(0);
@@ -907,133 +1000,411 @@ void TrainView::simpleShaderDraw(bool reverse)
 
 void TrainView::drawSurface()
 {
+	//the benchmark interleaves both ripple paths at a fixed tessellation, without the bake
+	bool bench = this->tw->rippleBench->value() != 0;
+	this->useRippleLut = bench ? (this->benchFrame++ % 2 == 0) : (this->tw->rippleLut->value() != 0);
+	bool bake = !bench && this->tw->bake->value() != 0;
+	bool tessBench = this->tw->tessBench->value() != 0;
+	bool adaptiveTess = tessBench ? (this->tessBenchFrame % 2 == 0) : (this->tw->adaptiveTess->value() != 0);
+
+	this->surfaceShader = this->surfaceVariants->get(this->getSurfaceVariant(bake));
 	this->surfaceShader->Use();
 #pragma region surfaceLighting
 
 	//Lighting------------------------------------------------
 
 
-	if (this->tw->shadingBrowser->selected(2))
-	{
-		this->surfaceShader->setInt("u_shadingSelect", 1); //0-No 1-Phong 2-Garudond
-	}
-	else if (this->tw->shadingBrowser->selected(3))
+	const SurfaceUniforms& uniforms = this->surfaceShader->handles<SurfaceUniforms>();
+	this->surfaceShader->set(uniforms.shadingSelect, this->getShadingSelect()); //0-No 1-Phong 2-Garudond 3-Toon
+	this->surfaceShader->set(uniforms.viewerPos, this->camera.eye);
+
+	//the lights are in the block bound before the objects were drawn
+
+
+
+	//Lighting------------------------------------------------
+#pragma endregion
+
+#pragma region surfaceDraw
+
+	//wave
+	this->updateWaveInputs();
+
+	if (bake)
 	{
-		this->surfaceShader->setInt("u_shadingSelect", 2); //0-No 1-Phong 2-Garudond
+		Shader* bakeShader = this->surfaceBaker->getShader();
+		bakeShader->Use();
+		this->setWaveUniforms(bakeShader);
+		this->surfaceBaker->bake((int)this->tw->bakeResolution->value());
 	}
-	else if (this->tw->shadingBrowser->selected(4))
+
+	//the CPU can not evaluate the image sequence or the GPU solver, it gets their surface a few frames late
+	if (this->waveField->needsReadback())
 	{
-		this->surfaceShader->setInt("u_shadingSelect", 3); //0-No 1-Phong 2-Garudond 3-Toon
+		Shader* readbackShader = this->heightReadback->getShader();
+		readbackShader->Use();
+		this->setWaveUniforms(readbackShader);
+		this->heightReadback->capture((int)this->tw->readbackResolution->value(), this->m_pTrack->trainU);
+		this->waveField->readback.heightSlope = this->heightReadback->getNormalHeight();
+		this->waveField->readback.resolution = this->heightReadback->getResolution();
 	}
-	else
+
+	this->surfaceShader->Use();
+	this->setWaveUniforms(this->surfaceShader);
+	this->surfaceShader->set(uniforms.realTimeRender, (int)(this->tw->realTimeRender->value() != 0));
+	this->surfaceShader->set(uniforms.useBake, (int)bake);
+	this->surfaceShader->set(uniforms.fixedTessLevel, bench ? 32.0f : 0.0f);
+	this->surfaceShader->set(uniforms.adaptiveTess, (int)adaptiveTess);
+	this->surfaceShader->set(uniforms.viewportHeight, (float)h());
+	this->surfaceShader->set(uniforms.tessPixels, this->tessPixels);
+	this->surfaceShader->set(uniforms.tessFlatScale, this->tessFlatScale);
+	this->surfaceShader->set(uniforms.tessSteepSlope, this->tessSteepSlope);
+	this->surfaceShader->set(uniforms.waveBound, this->getWaveBound());
+	if (bake)
 	{
-		this->surfaceShader->setInt("u_shadingSelect", 0); //0-No 1-Phong 2-Garudond	
+		this->surfaceBaker->getDisplacement()->bind(5);
+		this->surfaceShader->set(uniforms.bakeDisplacement, 5);
+		this->surfaceBaker->getNormal()->bind(6);
+		this->surfaceShader->set(uniforms.bakeNormal, 6);
 	}
-	this->surfaceShader->setVec3("u_viewer_pos", this->arcball.getEyePos());
-
-	this->surfaceShader->setVec3("dirLights[0].direction", 0.0f, -1.0f, -1.0f);
-	this->surfaceShader->setVec3("dirLights[0].ambient", 0.2f, 0.2f, 0.2f);
-	this->surfaceShader->setVec3("dirLights[0].diffuse", 1.0f, 1.0f, 1.0f);
-	this->surfaceShader->setVec3("dirLights[0].specular", 1.0f, 1.0f, 1.0f);
-
-	this->surfaceShader->setVec3("pointLights[0].position", this->lightBoxPos);
-	this->surfaceShader->setVec3("pointLights[0].ambient", 0.2f, 0.2f, 0.2f);
-	this->surfaceShader->setVec3("pointLights[0].diffuse", 1.0f, 1.0f, 1.0f);
-	this->surfaceShader->setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-	this->surfaceShader->setFloat("pointLights[0].constant", 1.0f);
-	this->surfaceShader->setFloat("pointLights[0].linear", 0.01f);
-	this->surfaceShader->setFloat("pointLights[0].quadratic", 0.0001f);
-
-	//this->surfaceShader->setVec3("spotLights[0].position", this->arcball.getEyePos());
-	//this->surfaceShader->setVec3("spotLights[0].ambient", 0.2f, 0.2f, 0.2f);
-	//this->surfaceShader->setVec3("spotLights[0].diffuse", 1.0f, 1.0f, 1.0f);
-	//this->surfaceShader->setVec3("spotLights[0].specular", 1.0f, 1.0f, 1.0f);
-	//this->surfaceShader->setFloat("spotLights[0].constant", 1.0f);
-	//this->surfaceShader->setFloat("spotLights[0].linear", 0);
-	//this->surfaceShader->setFloat("spotLights[0].quadratic", 0);
-	//this->surfaceShader->setVec3("spotLights[0].direction", -this->arcball.getEyePos());
-	//this->surfaceShader->setFloat("spotLights[0].cutoff", glm::cos(glm::radians(10.0f)));
-	//this->surfaceShader->setFloat("spotLights[0].outer_cutoff", glm::cos(glm::radians(15.0f)));
 
+	this->background->bind(10);
+	this->surfaceShader->set(uniforms.skybox, 10);
 
 
-	//Lighting------------------------------------------------
-#pragma endregion
+	this->surfaceShader->set(uniforms.refractTexture, 11);
 
-#pragma region surfaceDraw
+	this->surfaceShader->set(uniforms.reflectTexture, 12);
 
 	//wave
 
+	glm::mat4 model_matrix = glm::mat4();
+	model_matrix = glm::scale(model_matrix, glm::vec3(1.0f, 10.0f, 1.0f));
+	this->surfaceShader->setModel(model_matrix);
+	//this->texture->bind(0);
+
+	this->surfaceShader->set(uniforms.useTexture, 0);
+	GpuTimer& timer = tessBench ? (adaptiveTess ? this->adaptiveTessTimer : this->distanceTessTimer) :
+		!bench ? this->surfaceVariants->timer() : (this->useRippleLut ? this->lutTimer : this->transcendentalTimer);
+	PrimitiveCounter& primitives = adaptiveTess ? this->adaptiveTessPrimitives : this->distanceTessPrimitives;
+	//counted only on the orbit, so the reports never average in frames from outside the benchmark
+	timer.begin();
+	if (tessBench)
+		primitives.begin();
+	this->waterSurface.draw(this->surfaceShader, model_matrix);
+	if (tessBench)
+	{
+		primitives.end();
+		this->tessBenchFrame++;
+	}
+	timer.end();
+	this->texture->unbind(0);
+
+	//there is nothing to sample while streaming outside the height map waves
+	if (this->getHeightmap())
+		this->getHeightmap()->unbind(this->getHeightmapUnit());
+	if (this->getHeightmapSlope())
+		this->getHeightmapSlope()->unbind(9);
+	Texture2D::unbind(3);
+	Texture2D::unbind(4);
+	Texture2D::unbind(5);
+	Texture2D::unbind(6);
+	Texture2D::unbind(7);
+	this->background->unbind(10);
+#pragma endregion
 
-	this->surfaceShader->setVec2("u_direction", glm::vec2(1, -1));
-	this->surfaceShader->setFloat("u_time", this->m_pTrack->trainU);
-	this->surfaceShader->setFloat("u_wavelength", this->tw->waveLength->value());
-	this->surfaceShader->setFloat("u_amplitude", this->tw->amplitude->value());
-	this->surfaceShader->setBool("u_realTimeRender", this->tw->realTimeRender->value());
 
+}
+
+int TrainView::getWaveSelect()
+{
 	if (this->tw->waveBrowser->selected(2))
+		return 1;
+	if (this->tw->waveBrowser->selected(3))
+		return 2;
+	if (this->tw->waveBrowser->selected(4))
+		return 3;
+	return 0;
+}
+
+// 0 none, 1 Phong, 2 Gouraud, 3 toon
+int TrainView::getShadingSelect()
+{
+	if (this->tw->shadingBrowser->selected(2))
+		return 1;
+	if (this->tw->shadingBrowser->selected(3))
+		return 2;
+	if (this->tw->shadingBrowser->selected(4))
+		return 3;
+	return 0;
+}
+
+const std::string& TrainView::getWaveVariant(bool bake)
+{
+	if (bake)
+		return waveKeys[7];
+	switch (this->getWaveSelect())
 	{
-		this->surfaceShader->setInt("u_waveSelect", 1);
+	case 1:
+		return waveKeys[this->useOcean() ? 2 : 1];
+	case 2:
+		if (this->useRippleSolver())
+			return waveKeys[5];
+		return waveKeys[this->useRippleLut ? 4 : 3];
+	case 3:
+		return waveKeys[6];
+	default:
+		return waveKeys[0];
 	}
-	else if (this->tw->waveBrowser->selected(3))
+}
+
+unsigned int TrainView::getSurfaceVariant(bool bake)
+{
+	unsigned int mask = this->surfaceVariants->bit(this->getWaveVariant(bake)) |
+		this->surfaceVariants->bit(shadingKeys[this->getShadingSelect()]);
+	if (this->tw->realTimeRender->value())
+		mask |= this->surfaceVariants->bit("REALTIME_RENDER");
+	return mask;
+}
+
+//every combination the widgets can select, compiled while the generic programs draw
+void TrainView::precompileVariants()
+{
+	std::vector<unsigned int> masks;
+	for (const std::string& shading : shadingKeys)
+		masks.push_back(this->simpleVariants->bit(shading));
+	this->simpleVariants->precompile(masks);
+
+	masks.clear();
+	for (const std::string& wave : waveKeys)
 	{
-		this->surfaceShader->setInt("u_waveSelect", 2);
+		for (const std::string& shading : shadingKeys)
+		{
+			unsigned int mask = this->surfaceVariants->bit(wave) | this->surfaceVariants->bit(shading);
+			masks.push_back(mask);
+			masks.push_back(mask | this->surfaceVariants->bit("REALTIME_RENDER"));
+		}
 	}
-	else
+	this->surfaceVariants->precompile(masks);
+
+	masks.clear();
+	for (unsigned int effects = 0; effects < (1u << effectKeys.size()); effects++)
+		masks.push_back(effects);
+	this->postProcessVariants->precompile(masks);
+}
+
+bool TrainView::shadersReady()
+{
+	if (!this->shadersPending)
+		return true;
+	Shader* shaders[4] = { this->simpleShader, this->backgroundShader, this->surfaceShader, this->postProcessShader };
+	for (Shader* shader : shaders)
 	{
-		this->surfaceShader->setInt("u_waveSelect", 0);
+		if (!shader->isReady())
+			return false;
 	}
-	if (imgCounter >= imgInterval)
+	for (Shader* shader : shaders)
+		shader->finish();
+	this->shadersPending = false;
+
+	ProgramCache& cache = ProgramCache::shared();
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - this->shaderStart).count();
+	std::cout << "Shaders ready in " << ms << " ms: " << cache.hits << " from the cache, " << cache.misses << " compiled"
+		<< (cache.hasParallelCompile() ? " in parallel" : "") << ", " << cache.stores << " stored" << std::endl;
+	this->precompileVariants();
+	return true;
+}
+
+//the stream only exists while it is what gets drawn, the height map waves without the ocean,
+//and is freed again when switching away. Switching to the stream frees the resident stack once
+//nothing is loading into it any more. The stream reads waves.avi when there is one
+//(TexturePacker --video writes it) and the PNG sequence otherwise
+void TrainView::updateHeightmap()
+{
+	if (this->tw->streamHeightmap->value())
 	{
-		imgCounter = 0;
+		if (this->heightmap && ImageLoader::shared().pending() == 0)
+		{
+			delete this->heightmap;
+			this->heightmap = nullptr;
+			delete this->heightmapSlope;
+			this->heightmapSlope = nullptr;
+		}
+		if (this->getWaveSelect() == 1 && !this->useOcean())
+		{
+			if (!this->heightmapVideo && !this->heightmapStream)
+			{
+				if (fileExists(this->heightmapVideoPath))
+					this->heightmapVideo = new VideoHeightmapStream(this->heightmapVideoPath, this->heightmapWindow);
+				else
+					this->heightmapStream = new HeightmapStream(this->heightmapPaths, this->heightmapWindow);
+			}
+			float cursor = this->m_pTrack->trainU * this->heightmapRate;
+			if (this->heightmapVideo)
+				this->heightmapVideo->update(cursor);
+			else
+				this->heightmapStream->update(cursor);
+			return;
+		}
 	}
-	else
+
+	delete this->heightmapStream;
+	this->heightmapStream = nullptr;
+	delete this->heightmapVideo;
+	this->heightmapVideo = nullptr;
+	if (!this->heightmap && !this->tw->streamHeightmap->value())
 	{
-		imgCounter++;
+		TexturePack assets("../../Images/assets.pack");
+		if (assets.find("waves"))
+		{
+			this->heightmap = new Texture3D(assets, "waves");
+			if (assets.find("wavesSlope"))
+				this->heightmapSlope = new Texture3D(assets, "wavesSlope");
+		}
+		else
+			this->heightmap = Texture3D::loadAsync(this->heightmapPaths);
 	}
-	this->heightmap[imgIdx]->bind(2);
-	glUniform1i(glGetUniformLocation(this->surfaceShader->Program, "u_heightmap"), 2);
+}
 
-	this->background->bind(10);
-	glUniform1i(glGetUniformLocation(this->surfaceShader->Program, "u_skybox"), 10);
+Texture3D* TrainView::getHeightmap()
+{
+	if (this->heightmapVideo)
+		return this->heightmapVideo->getTexture();
+	return this->heightmapStream ? this->heightmapStream->getTexture() : this->heightmap;
+}
 
+//the slopes are sampled with the frame coordinate of the 3D stack, so only next to a stack of the same size
+Texture3D* TrainView::getHeightmapSlope()
+{
+	Texture3D* heightmap = this->getHeightmap();
+	if (!this->heightmapSlope || heightmap != this->heightmap || heightmap->target != GL_TEXTURE_3D ||
+		heightmap->size != this->heightmapSlope->size)
+		return nullptr;
+	return this->heightmapSlope;
+}
 
-	glUniform1i(glGetUniformLocation(this->surfaceShader->Program, "u_refractTexture"), 11);
+//block compressed frames come as an array, which can't share a unit with the 3D stack's sampler
+int TrainView::getHeightmapUnit()
+{
+	Texture3D* heightmap = this->getHeightmap();
+	return (heightmap && heightmap->target == GL_TEXTURE_2D_ARRAY) ? 8 : 2;
+}
 
-	glUniform1i(glGetUniformLocation(this->surfaceShader->Program, "u_reflectTexture"), 12);
+//runs the simulations and binds their textures, this may switch programs
+//so it has to happen before any uniform is set for the draw
+void TrainView::updateWaveInputs()
+{
+	if (this->getWaveSelect() == 3)
+	{
+		this->waveSet->setSettings(this->getWaveSetSettings());
+		this->waveSet->bind(1);
+	}
+	this->updateHeightmap();
+	if (this->getHeightmap())
+		this->getHeightmap()->bind(this->getHeightmapUnit());
+	if (this->getHeightmapSlope())
+		this->getHeightmapSlope()->bind(9);
 
-	int dropIdx = 0;
-	for (auto& v : this->drops)
+	if (this->useOcean())
 	{
-		this->surfaceShader->setFloat("u_dropTime[" + std::to_string(dropIdx) + "]", (v.first == 0.0f) ? 0.0001 : v.first);
-		this->surfaceShader->setVec2("u_drop[" + std::to_string(dropIdx) + "]", v.second);
-		dropIdx++;
-		if (dropIdx >= 100)
+		this->ocean->setSettings(this->getOceanSettings());
+		int resolution = this->ocean->getResolution();
+		if (!this->oceanMap || this->oceanMap->size.x != resolution)
+		{
+			delete this->oceanMap;
+			this->oceanMap = new Texture2D(resolution, resolution, GL_RGBA32F, GL_RGBA, GL_FLOAT);
+			this->oceanMap->setWrap(GL_REPEAT);
+			this->oceanTime = -1.0f;
+		}
+		if (this->oceanTime != this->m_pTrack->trainU)
 		{
-			break;
+			this->oceanTime = this->m_pTrack->trainU;
+			this->ocean->update(this->oceanTime);
+			this->oceanMap->update(this->ocean->getHeightSlope());
 		}
+		this->oceanMap->bind(4);
 	}
-	if (dropIdx < 100)
+
+	if (this->getWaveSelect() == 2 && !this->useRippleSolver())
 	{
-		this->surfaceShader->setFloat("u_dropTime[" + std::to_string(dropIdx) + "]", 0);
+		this->drops.setCapacity((int)this->tw->maxDrops->value());
+		this->dropBins->build(this->drops, this->m_pTrack->trainU, (float)this->tw->waveLength->value(), (float)this->tw->amplitude->value());
+		this->drops.bind(1);
+		this->dropBins->bind();
+		this->rippleLut->getTexture()->bind(7);
 	}
 
-	//wave
-
-	glm::mat4 model_matrix = glm::mat4();
-	model_matrix = glm::scale(model_matrix, glm::vec3(1.0f, 10.0f, 1.0f));
-	glUniformMatrix4fv(glGetUniformLocation(this->surfaceShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
-	//this->texture->bind(0);
-
-	this->surfaceShader->setBool("u_useTexture", false);
-	this->waterSurface.draw(this->surfaceShader, model_matrix);
-	this->texture->unbind(0);
+	if (this->useGpuSolver())
+	{
+		this->gpuWaveSolver->update();
+		this->gpuWaveSolver->getHeightSlope()->bind(3);
+	}
+	else if (this->useRippleSolver())
+	{
+		if (this->waveSolver->dirty)
+		{
+			this->simMap->update(this->waveSolver->getHeightSlope());
+			this->waveSolver->dirty = false;
+		}
+		this->simMap->bind(3);
+	}
+	this->updateWaveField();
+}
 
-	this->heightmap[imgIdx]->unbind(2);
-	this->background->unbind(10);
-#pragma endregion
+glm::vec3 TrainView::getWaveBound()
+{
+	//the margin covers the filtering of the texture models. Until a readback arrives only the
+	//pool walls bound the height of the water
+	float sideways = this->waveField->horizontalBound() * 1.25f + 1.0f;
+	if (!this->waveField->isAvailable())
+		return glm::vec3(sideways, this->picker.top, sideways);
+	return glm::vec3(sideways, this->waveField->bound() * 1.25f + 1.0f, sideways);
+}
 
+void TrainView::updateWaveField()
+{
+	WaveField::Parameters& parameters = this->waveField->parameters;
+	parameters.waveSelect = this->getWaveSelect();
+	parameters.time = this->m_pTrack->trainU;
+	parameters.wavelength = (float)this->tw->waveLength->value();
+	parameters.amplitude = (float)this->tw->amplitude->value();
+	parameters.useOcean = this->useOcean();
+	parameters.useSolver = this->useRippleSolver();
+
+	this->waveField->ocean.heightSlope = this->useOcean() ? this->ocean->getHeightSlope() : nullptr;
+	this->waveField->ocean.resolution = this->ocean->getResolution();
+	bool cpuSolver = this->useRippleSolver() && !this->useGpuSolver();
+	this->waveField->solver.heightSlope = cpuSolver ? this->waveSolver->getHeightSlope() : nullptr;
+	this->waveField->solver.resolution = this->waveSolver->getResolution();
+}
 
+//uniforms read by waveFunctions.glsl, shared by the surface and the bake pass
+void TrainView::setWaveUniforms(Shader* shader)
+{
+	const WaveUniforms& uniforms = shader->handles<WaveUniforms>();
+	shader->set(uniforms.direction, glm::vec2(1, -1));
+	shader->set(uniforms.time, this->m_pTrack->trainU);
+	shader->set(uniforms.wavelength, (float)this->tw->waveLength->value());
+	shader->set(uniforms.amplitude, (float)this->tw->amplitude->value());
+	shader->set(uniforms.waveSelect, this->getWaveSelect());
+	shader->set(uniforms.useOcean, (int)this->useOcean());
+	shader->set(uniforms.simSelect, this->useRippleSolver() ? 1 : 0);
+	shader->set(uniforms.heightmap, 2);
+	shader->set(uniforms.heightmapLayers, 8);
+	Texture3D* heightmap = this->getHeightmap();
+	shader->set(uniforms.heightmapArray, (int)(heightmap && heightmap->target == GL_TEXTURE_2D_ARRAY));
+	//a stream's texture only holds its window, which the shader wraps around the same way
+	shader->set(uniforms.heightmapFrames, heightmap ? (float)heightmap->size.z : 1.0f);
+	shader->set(uniforms.heightmapRate, this->heightmapRate);
+	shader->set(uniforms.heightmapSlope, 9);
+	shader->set(uniforms.useHeightmapSlope, (int)(this->getHeightmapSlope() != nullptr));
+	shader->set(uniforms.simMap, 3);
+	shader->set(uniforms.oceanMap, 4);
+
+	shader->set(uniforms.dropGridSize, this->dropBins->getGridSize());
+	shader->set(uniforms.useRippleLut, (int)this->useRippleLut);
+	shader->set(uniforms.rippleLut, 7);
+	shader->set(uniforms.rippleLutRange, glm::vec2(this->rippleLut->ringRange, this->rippleLut->ageRange));
 }
 
 void TrainView::drawBackground(glm::mat4 view_matrix, glm::mat4 projection_matrix)
@@ -1041,23 +1412,15 @@ void TrainView::drawBackground(glm::mat4 view_matrix, glm::mat4 projection_matri
 	//Background
 	this->backgroundShader->Use();
 	glDepthMask(false);
-	if (projection_matrix == glm::mat4())
-	{
-		glGetFloatv(GL_PROJECTION_MATRIX, &projection_matrix[0][0]);
-	}
-	glUniformMatrix4fv(glGetUniformLocation(this->backgroundShader->Program, "u_projection"), 1, GL_FALSE, &projection_matrix[0][0]);
+	this->backgroundShader->setMat4("u_projection", projection_matrix);
 
-	if (view_matrix == glm::mat4())
-	{
-		glGetFloatv(GL_MODELVIEW_MATRIX, &view_matrix[0][0]);
-	}
 	view_matrix = glm::mat4(glm::mat3(view_matrix));
-	glUniformMatrix4fv(glGetUniformLocation(this->backgroundShader->Program, "u_view"), 1, GL_FALSE, &view_matrix[0][0]);
+	this->backgroundShader->setMat4("u_view", view_matrix);
 
 	glm::mat4 model_matrix = glm::mat4();
 
 	this->background->bind(0);
-	glUniform1i(glGetUniformLocation(this->backgroundShader->Program, "u_skybox"), 0);
+	this->backgroundShader->setInt("u_skybox", 0);
 
 	this->bgPlane.draw(this->backgroundShader, model_matrix);
 
@@ -1097,9 +1460,14 @@ setProjection()
 	// Compute the aspect ratio (we'll need it)
 	float aspect = static_cast<float>(w()) / static_cast<float>(h());
 
+	glm::mat4 view_matrix;
+	glm::mat4 projection_matrix;
+
 	// Check whether we use the world camp
-	if (tw->worldCam->value())
-		arcball.setProjection(false);
+	if (tw->worldCam->value()) {
+		view_matrix = arcball.getViewMatrix();
+		projection_matrix = arcball.getProjectionMatrix();
+	}
 	// Or we use the top cam
 	else if (tw->topCam->value()) {
 		float wi, he;
@@ -1114,11 +1482,8 @@ setProjection()
 
 		// Set up the top camera drop mode to be orthogonal and set
 		// up proper projection matrix
-		glMatrixMode(GL_PROJECTION);
-		glOrtho(-wi, wi, -he, he, 200, -200);
-		glMatrixMode(GL_MODELVIEW);
-		glLoadIdentity();
-		glRotatef(-90, 1, 0, 0);
+		projection_matrix = glm::ortho(-wi, wi, -he, he, 200.0f, -200.0f);
+		view_matrix = glm::rotate(glm::radians(-90.0f), glm::vec3(1, 0, 0));
 	}
 	// Or do the train view or other view here
 	//####################################################################
@@ -1130,6 +1495,25 @@ setProjection()
 		trainCamView(this, aspect);
 #endif
 	}
+
+	// every pass of the frame takes its matrices from here, the stacks
+	// are only loaded for the fixed-function drawing and never read back
+	glm::vec3 eye = this->arcball.getEyePos();
+
+	// the tessellation benchmark flies a fixed orbit, each camera is drawn once per scheme
+	if (this->tw->tessBench->value()) {
+		float angle = glm::radians(0.5f * (this->tessBenchFrame / 2 % 720));
+		eye = glm::vec3(160.0f * cos(angle), 35.0f + 25.0f * sin(3.0f * angle), 160.0f * sin(angle));
+		glm::vec3 target = glm::vec3(60.0f * cos(angle + 2.0f), 0.0f, 60.0f * sin(angle + 2.0f));
+		view_matrix = glm::lookAt(eye, target, glm::vec3(0, 1, 0));
+		projection_matrix = this->arcball.getProjectionMatrix();
+	}
+
+	this->camera.update(view_matrix, projection_matrix, eye);
+	glMatrixMode(GL_PROJECTION);
+	glMultMatrixf(&projection_matrix[0][0]);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadMatrixf(&view_matrix[0][0]);
 }
 
 //************************************************************************
@@ -1246,49 +1630,77 @@ doPick()
 	//	selectedCube = -1;
 
 	//printf("Selected Cube %d\n", selectedCube);
-	if (this->tw->waveBrowser->selected(3))
+	Picker::Hit hit = this->pickUnderMouse();
+	if (hit.kind == Picker::Water && this->tw->waveBrowser->selected(3))
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, this->pickSurfaceBuffer);
-		glClearColor(0.0f, 0.0f, 1.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		this->pickShader->Use();
-		//this->pickShader->setMat4("u_model", model_matrix);
-		this->plane.draw(this->pickShader, glm::scale(glm::vec3(200, 1, 200)));
-
-		glReadBuffer(GL_COLOR_ATTACHMENT0);
-		glm::vec3 picker;
-		int viewport[4];
-		glGetIntegerv(GL_VIEWPORT, viewport);
-		int mx = Fl::event_x();
-		int my = viewport[3] - Fl::event_y();
-		glReadPixels(mx, my, 1, 1, GL_RGB, GL_FLOAT, &picker[0]);
-		glReadBuffer(GL_NONE);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		std::cout << "Selecting: " + std::to_string(hit.uv.x) + ", " + std::to_string(hit.uv.y) << std::endl;
+		this->addDrop(hit.uv);
+	}
+	else if (hit.kind == Picker::Box || hit.kind == Picker::Sphere)
+	{
+		std::cout << "Selecting: " << (hit.kind == Picker::Box ? "light box" : "sphere") << std::endl;
+	}
+}
 
-		if (picker.b != 1.0f)
+Picker::Hit TrainView::pickUnderMouse()
+{
+	//the objects simpleShaderDraw draws, the light box is a unit cube and the sphere is scaled by 10
+	this->picker.boxes.assign(1, { this->lightBoxPos - glm::vec3(5.0f), this->lightBoxPos + glm::vec3(5.0f) });
+	this->picker.spheres.assign(1, { glm::vec3(0, 50, 0), this->sphere.sp.getRadius() * 10.0f });
+	this->picker.waveBound = this->waveField->bound();
+	Picker::Ray ray = Picker::mouseRay(this->camera.main.view, this->camera.main.projection,
+		(float)Fl::event_x(), (float)Fl::event_y(), w(), h());
+	return this->picker.cast(ray);
+}
+
+void TrainView::updateLamps()
+{
+	bool on = this->tw->lamps->value() != 0;
+	if (on == this->lampsOn)
+		return;
+	this->lampsOn = on;
+	//the light box stays, everything after it is a lamp
+	this->lights.points.resize(1);
+	LightSet::Directional& sun = this->lights.directional[0];
+	sun = LightSet::Directional();
+	sun.direction = glm::vec3(0.0f, -1.0f, -1.0f);
+	if (!on)
+		return;
+
+	//night, the lamps do the lighting
+	sun.ambient = glm::vec3(0.02f);
+	sun.diffuse = glm::vec3(0.1f);
+	sun.specular = glm::vec3(0.1f);
+	//a row of warm lamps along each of the four walls, just above the water
+	const int perWall = 60;
+	for (int wall = 0; wall < 4; wall++)
+	{
+		for (int i = 0; i < perWall; i++)
 		{
-			std::cout << "Selecting: " + std::to_string(picker.x) + ", " + std::to_string(picker.y) << std::endl;
-			this->drops[this->m_pTrack->trainU] = glm::vec2(picker.x, picker.y);
+			float along = -95.0f + 190.0f * (i + 0.5f) / perWall;
+			float side = wall & 1 ? 95.0f : -95.0f;
+			LightSet::Point lamp;
+			lamp.position = wall < 2 ? glm::vec3(along, 10.0f, side) : glm::vec3(side, 10.0f, along);
+			lamp.ambient = glm::vec3(0.0f);
+			lamp.diffuse = glm::vec3(1.0f, 0.75f, 0.4f);
+			lamp.specular = lamp.diffuse * 0.5f;
+			lamp.linear = 0.35f;
+			lamp.quadratic = 0.44f;
+			this->lights.points.push_back(lamp);
 		}
-
-
 	}
-
 }
 
 void TrainView::setViewAndProjToUBO()
+{
+	this->setViewAndProjToUBO(this->camera.main.view, this->camera.main.projection);
+}
+
+void TrainView::setViewAndProjToUBO(glm::mat4 view_matrix, glm::mat4 projection_matrix)
 {
 	float wdt = this->pixel_w();
 	float hgt = this->pixel_h();
 
-	glm::mat4 view_matrix;
-	glGetFloatv(GL_MODELVIEW_MATRIX, &view_matrix[0][0]);
-	//HMatrix view_matrix; 
-	//this->arcball.getMatrix(view_matrix);
-
-	glm::mat4 projection_matrix;
-	glGetFloatv(GL_PROJECTION_MATRIX, &projection_matrix[0][0]);
-	//projection_matrix = glm::perspective(glm::radians(this->arcball.getFoV()), (GLfloat)wdt / (GLfloat)hgt, 0.01f, 1000.0f);
 
 	glBindBuffer(GL_UNIFORM_BUFFER, this->commom_matrices->ubo);
 	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), &projection_matrix[0][0]);
@@ -1296,16 +1708,80 @@ void TrainView::setViewAndProjToUBO()
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
-void TrainView::setViewAndProjToUBO(glm::mat4 view_matrix, glm::mat4 projection_matrix)
+void TrainView::addDrop(const glm::vec2& uv)
 {
-	float wdt = this->pixel_w();
-	float hgt = this->pixel_h();
+	if (this->useGpuSolver())
+	{
+		this->gpuWaveSolver->addImpulse(uv);
+	}
+	else if (this->useRippleSolver())
+	{
+		this->waveSolver->addImpulse(uv);
+	}
+	else
+	{
+		this->drops.push(uv, this->m_pTrack->trainU);
+	}
+}
 
+//the solvers only run for the interactive waves, like the ocean only for the height map
+bool TrainView::useRippleSolver()
+{
+	return this->getWaveSelect() == 2 && (this->tw->simBrowser->selected(2) || this->tw->simBrowser->selected(3));
+}
 
-	glBindBuffer(GL_UNIFORM_BUFFER, this->commom_matrices->ubo);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), &projection_matrix[0][0]);
-	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), &view_matrix[0][0]);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+bool TrainView::useGpuSolver()
+{
+	return this->getWaveSelect() == 2 && this->tw->simBrowser->selected(3);
+}
+
+bool TrainView::useOcean()
+{
+	return this->tw->waveBrowser->selected(2) && this->tw->fftOcean->value();
+}
+
+OceanFFT::Settings TrainView::getOceanSettings()
+{
+	OceanFFT::Settings settings;
+	for (int i = 1; i <= this->tw->oceanResBrowser->size(); i++)
+	{
+		if (this->tw->oceanResBrowser->selected(i))
+			settings.resolution = 64 << i;
+	}
+	settings.windSpeed = (float)this->tw->windSpeed->value();
+	float angle = glm::radians((float)this->tw->windAngle->value());
+	settings.windDirection = glm::vec2(glm::cos(angle), glm::sin(angle));
+	settings.spectrum = this->tw->jonswap->value() ? OceanFFT::JONSWAP : OceanFFT::PHILLIPS;
+	return settings;
+}
+
+WaveSet::Settings TrainView::getWaveSetSettings()
+{
+	WaveSet::Settings settings;
+	settings.count = (int)this->tw->waveCount->value();
+	//the sliders are in texture units, the waves in world units
+	settings.wavelength = (float)this->tw->waveLength->value() * 200.0f;
+	settings.amplitude = (float)this->tw->amplitude->value();
+	settings.steepness = (float)this->tw->steepness->value();
+	settings.angle = (float)this->tw->windAngle->value();
+	settings.spread = (float)this->tw->waveSpread->value();
+	settings.seed = this->waveSeed;
+	return settings;
+}
+
+void TrainView::addRandomDrops(int amount)
+{
+	//analytic drops live in the ring, grow it so the whole batch is compared and not just its tail
+	if (!this->useRippleSolver() && amount > (int)this->tw->maxDrops->value())
+	{
+		this->tw->maxDrops->value(glm::min((double)amount, this->tw->maxDrops->maximum()));
+		this->drops.setCapacity((int)this->tw->maxDrops->value());
+	}
+	for (int i = 0; i < amount; i++)
+	{
+		this->addDrop(glm::vec2((rand() % 1000) / 1000.0, (rand() % 1000) / 1000.0));
+	}
+	std::cout << "Added " << amount << " drops" << std::endl;
 }
 
 void TrainView::setUseTexture(bool set)
@@ -1313,6 +1789,6 @@ void TrainView::setUseTexture(bool set)
 	GLboolean to = set;
 	/*int u_useTextureLocation = glGetUniformLocation(this->shader->Program, "u_useTexture");
 	glUniform1i(u_useTextureLocation, to);*/
-	this->simpleShader->setBool("u_useTexture", set);
+	this->simpleShader->set(this->simpleShader->handles<ObjectUniforms>().useTexture, (int)set);
 }
 
@@ -43,7 +43,7 @@
 //========================================================================
 TrainWindow::
 TrainWindow(const int x, const int y)
-	: Fl_Double_Window(x, y, 800, 600, "Train and Roller Coaster")
+	: Fl_Double_Window(x, y, 800, 720, "Train and Roller Coaster")
 	//========================================================================
 {
 	// make all of the widgets
@@ -51,13 +51,13 @@ TrainWindow(const int x, const int y)
 	{
 		int pty = 5;			// where the last widgets were drawn
 
-		trainView = new TrainView(5, 5, 590, 590);
+		trainView = new TrainView(5, 5, 590, 710);
 		trainView->tw = this;
 		trainView->m_pTrack = &m_Track;
 		this->resizable(trainView);
 
 		// to make resizing work better, put all the widgets in a group
-		widgets = new Fl_Group(600, 5, 190, 590);
+		widgets = new Fl_Group(600, 5, 190, 710);
 		widgets->begin();
 
 		runButton = new Fl_Button(605, pty, 60, 20, "Run");
@@ -68,6 +68,9 @@ TrainWindow(const int x, const int y)
 		Fl_Button* rb = new Fl_Button(670, pty, 25, 20, "@<<");
 		rb->callback((Fl_Callback*)backCB, this);
 
+		tessBench = new Fl_Button(735, pty, 60, 20, "TBench");
+		togglify(tessBench);
+
 		pty += 25;
 		speed = new Fl_Value_Slider(655, pty, 140, 20, "speed");
 		speed->range(0, 5);
@@ -133,6 +136,7 @@ TrainWindow(const int x, const int y)
 		waveBrowser->add("Sine");
 		waveBrowser->add("Height Map");
 		waveBrowser->add("Interactive");
+		waveBrowser->add("Gerstner");
 		waveBrowser->select(1);
 
 		pty += 110;
@@ -141,6 +145,12 @@ TrainWindow(const int x, const int y)
 		togglify(rain);
 		rain->callback((Fl_Callback*)damageCB, this);
 
+		rippleLut = new Fl_Button(670, pty, 60, 20, "LUT");
+		togglify(rippleLut, 1);
+
+		rippleBench = new Fl_Button(735, pty, 60, 20, "Bench");
+		togglify(rippleBench);
+
 		pty += 30;
 
 		pixelation = new Fl_Button(605, pty, 60, 20, "Pixel");
@@ -156,17 +166,130 @@ TrainWindow(const int x, const int y)
 		rotate->callback((Fl_Callback*)damageCB, this);
 
 		pty += 30;
-		realTimeRender = new Fl_Button(605, pty, 150, 20, "RealTimeRender");
+		realTimeRender = new Fl_Button(605, pty, 125, 20, "RealTimeRender");
 		togglify(realTimeRender);
 		realTimeRender->callback((Fl_Callback*)damageCB, this);
 
+		lamps = new Fl_Button(735, pty, 60, 20, "Lamps");
+		togglify(lamps);
+		lamps->callback((Fl_Callback*)damageCB, this);
+
+		pty += 30;
+		simBrowser = new Fl_Browser(605, pty, 90, 60, "Ripple Solver");
+		simBrowser->type(2);		// select
+		simBrowser->callback((Fl_Callback*)damageCB, this);
+		simBrowser->add("Analytic");
+		simBrowser->add("CPU Solver");
+		simBrowser->add("GPU Solver");
+		simBrowser->select(2);
+
+		oceanResBrowser = new Fl_Browser(700, pty, 90, 60, "Ocean Res");
+		oceanResBrowser->type(2);		// select
+		oceanResBrowser->callback((Fl_Callback*)damageCB, this);
+		oceanResBrowser->add("128");
+		oceanResBrowser->add("256");
+		oceanResBrowser->add("512");
+		oceanResBrowser->add("1024");
+		oceanResBrowser->select(2);
+		pty += 80;
+
+		fftOcean = new Fl_Button(605, pty, 60, 20, "FFT");
+		togglify(fftOcean, 1);
+
+		jonswap = new Fl_Button(670, pty, 80, 20, "JONSWAP");
+		togglify(jonswap);
+
+		adaptiveTess = new Fl_Button(755, pty, 40, 20, "Tess");
+		togglify(adaptiveTess, 1);
+
+		pty += 30;
+		windSpeed = new Fl_Value_Slider(655, pty, 140, 20, "Wind");
+		windSpeed->range(1, 40);
+		windSpeed->value(20);
+		windSpeed->align(FL_ALIGN_LEFT);
+		windSpeed->type(FL_HORIZONTAL);
+		windSpeed->callback((Fl_Callback*)damageCB, this);
+
+		pty += 30;
+		windAngle = new Fl_Value_Slider(655, pty, 140, 20, "WindDir");
+		windAngle->range(0, 360);
+		windAngle->value(315);
+		windAngle->align(FL_ALIGN_LEFT);
+		windAngle->type(FL_HORIZONTAL);
+		windAngle->callback((Fl_Callback*)damageCB, this);
+		pty += 30;
+
+		// Gerstner set, the median wave follows Amp/waveLen and WindDir
+		waveCount = new Fl_Value_Slider(655, pty, 140, 20, "Waves");
+		waveCount->range(1, 64);
+		waveCount->step(1);
+		waveCount->value(8);
+		waveCount->align(FL_ALIGN_LEFT);
+		waveCount->type(FL_HORIZONTAL);
+		waveCount->callback((Fl_Callback*)damageCB, this);
+
+		pty += 30;
+		steepness = new Fl_Value_Slider(655, pty, 140, 20, "Steep");
+		steepness->range(0, 1);
+		steepness->value(0.5);
+		steepness->align(FL_ALIGN_LEFT);
+		steepness->type(FL_HORIZONTAL);
+		steepness->callback((Fl_Callback*)damageCB, this);
+
+		pty += 30;
+		waveSpread = new Fl_Value_Slider(655, pty, 140, 20, "Spread");
+		waveSpread->range(0, 180);
+		waveSpread->value(60);
+		waveSpread->align(FL_ALIGN_LEFT);
+		waveSpread->type(FL_HORIZONTAL);
+		waveSpread->callback((Fl_Callback*)damageCB, this);
+
+		pty += 30;
+		rerollWaves = new Fl_Button(605, pty, 60, 20, "Reroll");
+		rerollWaves->callback((Fl_Callback*)rerollWavesCB, this);
+
+		bake = new Fl_Button(670, pty, 60, 20, "Bake");
+		togglify(bake);
+
+		// keep only a window of the height map frames on the GPU
+		streamHeightmap = new Fl_Button(735, pty, 60, 20, "Stream");
+		togglify(streamHeightmap);
+
+		pty += 30;
+		bakeResolution = new Fl_Value_Slider(655, pty, 140, 20, "BakeRes");
+		bakeResolution->range(128, 2048);
+		bakeResolution->step(128);
+		bakeResolution->value(512);
+		bakeResolution->align(FL_ALIGN_LEFT);
+		bakeResolution->type(FL_HORIZONTAL);
+		bakeResolution->callback((Fl_Callback*)damageCB, this);
+
+		pty += 30;
+		maxDrops = new Fl_Value_Slider(655, pty, 140, 20, "MaxDrops");
+		maxDrops->range(10, 10000);
+		maxDrops->step(10);
+		maxDrops->value(100);
+		maxDrops->align(FL_ALIGN_LEFT);
+		maxDrops->type(FL_HORIZONTAL);
+		maxDrops->callback((Fl_Callback*)damageCB, this);
+
+		pty += 30;
+		readbackResolution = new Fl_Value_Slider(655, pty, 140, 20, "ReadRes");
+		readbackResolution->range(16, 512);
+		readbackResolution->step(16);
+		readbackResolution->value(128);
+		readbackResolution->align(FL_ALIGN_LEFT);
+		readbackResolution->type(FL_HORIZONTAL);
+		readbackResolution->callback((Fl_Callback*)damageCB, this);
+		pty += 30;
+
 		// TODO: add widgets for all of your fancier features here
 #ifdef EXAMPLE_SOLUTION
 		makeExampleWidgets(this, pty);
 #endif
 
 		// we need to make a little phantom widget to have things resize correctly
-		Fl_Box* resizebox = new Fl_Box(600, 595, 200, 5);
+		Fl_Box* resizebox = new Fl_Box(600, 715, 200, 5);
 		widgets->resizable(resizebox);
 
 		widgets->end();
@@ -218,14 +341,20 @@ advanceTrain(float dir)
 	this->trainView->lightBoxPos = rot * glm::vec4(this->trainView->lightBoxPos, 1.0f);
 	this->m_Track.trainU += dir * (float)this->speed->value()*0.02f;
 
-	this->trainView->imgIdx++;
-	if (this->trainView->imgIdx >= this->trainView->heightmap.size())
+	if (this->trainView->useGpuSolver())
+	{
+		this->trainView->gpuWaveSolver->requestStep();
+	}
+	else if (this->trainView->useRippleSolver())
 	{
-		this->trainView->imgIdx = 0;
+		this->trainView->waveSolver->step();
 	}
-	while ((!this->trainView->drops.empty()) && this->m_Track.trainU - (*this->trainView->drops.begin()).first > 30.0f)
+	//drops are gone once their ripple is below the bin threshold everywhere
+	DropRing& drops = this->trainView->drops;
+	while (!drops.empty() && this->m_Track.trainU - drops.oldest().startTime >
+		this->trainView->dropBins->lifetime((float)this->amplitude->value() * drops.oldest().amplitude))
 	{
-		this->trainView->drops.erase(this->trainView->drops.begin());
+		drops.popOldest();
 	}
 	static int rainDelay = 0;
 	if (rain->value())
@@ -234,14 +363,8 @@ advanceTrain(float dir)
 		if (rainDelay < 0)
 		{
 			rainDelay = (rand() % (int)(2000/(float)this->speed->value()) + 100) / 60;
-			if (this->trainView->drops.size() < 30)
-			{
-				this->trainView->drops[this->m_Track.trainU] = glm::vec2((rand() % 1000) / 1000.0, (rand() % 1000) / 1000.0);
-			}
-			else
-			{
-				this->trainView->drops.erase(this->trainView->drops.begin());
-			}
+			//a full ring drops its oldest ripple
+			this->trainView->addDrop(glm::vec2((rand() % 1000) / 1000.0, (rand() % 1000) / 1000.0));
 		}
 	}
 
@@ -36,6 +36,7 @@
 #include <GL/glu.h>
 
 #include "3DUtils.H"
+#include <glm/gtc/matrix_transform.hpp>
 
 #include <vector>
 using std::vector;
@@ -233,25 +234,26 @@ void unsetupShadows(void)
 //   plane, so we can be a little more well-balanced
 //   this code mimics page 147 of the OpenGL book
 //===============================================================================
-int getMouseLine(double& x1, double& y1, double& z1,
+int getMouseLine(const glm::mat4& view, const glm::mat4& projection,
+								 int width, int height,
+								 double& x1, double& y1, double& z1,
 								 double& x2, double& y2, double& z2)
 //===============================================================================
 {
   int x = Fl::event_x();
   int iy = Fl::event_y();
 
-  double mat1[16],mat2[16];		// we have to deal with the projection matrices
-  int viewport[4];
+  glm::vec4 viewport(0, 0, width, height);
+  int y = height - iy; // originally had an extra -1?
 
-  glGetIntegerv(GL_VIEWPORT, viewport);
-  glGetDoublev(GL_MODELVIEW_MATRIX,mat1);
-  glGetDoublev(GL_PROJECTION_MATRIX,mat2);
-
-  int y = viewport[3] - iy; // originally had an extra -1?
-
-  int i1 = gluUnProject((double) x, (double) y, .25, mat1, mat2, viewport, &x1, &y1, &z1);
-  int i2 = gluUnProject((double) x, (double) y, .75, mat1, mat2, viewport, &x2, &y2, &z2);
+  // a singular matrix would give nans, like gluUnProject failing
+  glm::vec3 p1 = glm::unProject(glm::vec3(x, y, .25f), view, projection, viewport);
+  glm::vec3 p2 = glm::unProject(glm::vec3(x, y, .75f), view, projection, viewport);
+  x1 = p1.x; y1 = p1.y; z1 = p1.z;
+  x2 = p2.x; y2 = p2.y; z2 = p2.z;
 
+  int i1 = !glm::any(glm::isnan(p1));
+  int i2 = !glm::any(glm::isnan(p2));
   return i1 && i2;
 }
 
@@ -27,6 +27,7 @@
 
 *************************************************************************/
 #pragma once
+#include <glm/glm.hpp>
 
 //************************************************************************
 // this typedef is useful for lots of stuff
@@ -103,7 +104,11 @@ void unsetupShadows(void);
 // Given the position of the mouse in 2D, we need to figure out where
 // it is in 3D. of course, its not in one place, its a line
 // this function gets that ray for you (well, it gets 2 points on the line)
-int getMouseLine(double& p1x, double& p1y, double& p1z,
+// the matrices and the viewport size are the ones the frame was drawn with,
+// nothing is read back from OpenGL
+int getMouseLine(const glm::mat4& view, const glm::mat4& projection,
+								 int width, int height,
+								 double& p1x, double& p1y, double& p1z,
 								 double& p2x, double& p2y, double& p2z);
 			  
 //************************************************************************
@@ -63,6 +63,7 @@
 #include <Fl/Fl.h>
 #include <GL/gl.h>
 #include <GL/glu.h>
+#include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <Fl/Fl_Double_Window.h>
 #pragma warning(pop)
@@ -123,18 +124,37 @@ setProjection(bool doClear)
   glMatrixMode(GL_PROJECTION);
   if (doClear)
 	  glLoadIdentity();
-
-  // Compute the aspect ratio so we don't distort things
-  double aspect = ((double) wind->w()) / ((double) wind->h());
-  gluPerspective(fieldOfView, aspect, .1, 3000);
+  glMultMatrixf(glm::value_ptr(getProjectionMatrix()));
 
   // Put the camera where we want it to be
   glMatrixMode(GL_MODELVIEW);
-  glLoadIdentity();
+  glLoadMatrixf(glm::value_ptr(getViewMatrix()));
+}
+
+//**************************************************************************
+//
+// * The projection, from the field of view and the window shape
+//==========================================================================
+glm::mat4 ArcBallCam::
+getProjectionMatrix() const
+//==========================================================================
+{
+  // Compute the aspect ratio so we don't distort things
+  float aspect = ((float) wind->w()) / ((float) wind->h());
+  return glm::perspective(glm::radians(fieldOfView), aspect, .1f, 3000.0f);
+}
 
-  // Use the transformation in the ArcBall
-  glTranslatef(-eyeX, -eyeY, -eyeZ);
-  multMatrix();
+//**************************************************************************
+//
+// * The view, the eye offset and then the rotation of the ball
+//==========================================================================
+glm::mat4 ArcBallCam::
+getViewMatrix() const
+//==========================================================================
+{
+  HMatrix m;
+  getMatrix(m);
+  return glm::translate(glm::mat4(), glm::vec3(-eyeX, -eyeY, -eyeZ)) * glm::make_mat4((float*) m);
 }
 
 //**************************************************************************
@@ -0,0 +1,105 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <queue>
+#include <vector>
+
+//Small fixed size worker pool shared by the CPU side simulations
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned int threads = std::thread::hardware_concurrency())
+	{
+		if (threads == 0)
+			threads = 1;
+		for (unsigned int i = 0; i < threads; i++)
+		{
+			this->workers.emplace_back([this]()
+			{
+				for (;;)
+				{
+					std::function<void()> task;
+					{
+						std::unique_lock<std::mutex> lock(this->mutex);
+						this->condition.wait(lock, [this]() { return this->stopping || !this->tasks.empty(); });
+						if (this->stopping && this->tasks.empty())
+							return;
+						task = std::move(this->tasks.front());
+						this->tasks.pop();
+					}
+					task();
+				}
+			});
+		}
+	}
+	~ThreadPool()
+	{
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->stopping = true;
+		}
+		this->condition.notify_all();
+		for (std::thread& worker : this->workers)
+			worker.join();
+	}
+
+	template<class F>
+	std::future<void> enqueue(F f)
+	{
+		auto task = std::make_shared<std::packaged_task<void()>>(f);
+		std::future<void> result = task->get_future();
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->tasks.emplace([task]() { (*task)(); });
+		}
+		this->condition.notify_one();
+		return result;
+	}
+
+	//Split [begin, end) into one band per worker, the caller runs the last band itself
+	void parallelFor(int begin, int end, const std::function<void(int, int)>& body)
+	{
+		int count = end - begin;
+		if (count <= 0)
+			return;
+		int bands = (int)this->workers.size() + 1;
+		if (bands > count)
+			bands = count;
+		int bandSize = (count + bands - 1) / bands;
+
+		std::vector<std::future<void>> pending;
+		int bandBegin = begin;
+		for (int i = 0; i < bands - 1 && bandBegin + bandSize < end; i++)
+		{
+			int bandEnd = bandBegin + bandSize;
+			pending.push_back(this->enqueue([&body, bandBegin, bandEnd]() { body(bandBegin, bandEnd); }));
+			bandBegin = bandEnd;
+		}
+		if (bandBegin < end)
+			body(bandBegin, end);
+		for (std::future<void>& f : pending)
+			f.get();
+	}
+
+	unsigned int size() const
+	{
+		return (unsigned int)this->workers.size();
+	}
+
+	static ThreadPool& shared()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+};
@@ -0,0 +1,232 @@
+#include "VideoHeightmapStream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	long long wrap(long long value, long long size)
+	{
+		long long result = value % size;
+		return (result < 0) ? result + size : result;
+	}
+}
+
+VideoHeightmapStream::VideoHeightmapStream(const std::string& path, int window, int capacity) :
+	window(std::max(window, 2)), capacity(std::max(capacity, 2))
+{
+	//size and length come from the container, nothing is decoded on the GL thread
+	if (this->capture.open(path))
+	{
+		this->width = std::max((int)this->capture.get(cv::CAP_PROP_FRAME_WIDTH), 1);
+		this->height = std::max((int)this->capture.get(cv::CAP_PROP_FRAME_HEIGHT), 1);
+		this->frameCount = std::max((int)this->capture.get(cv::CAP_PROP_FRAME_COUNT), 1);
+	}
+	else
+		std::cout << "Could not open heightmap video " << path << std::endl;
+	this->frameSize = (size_t)this->width * this->height;
+
+	this->texture = new Texture3D(this->width, this->height, this->window, GL_R8, GL_RED, GL_UNSIGNED_BYTE);
+	this->slotFrame.assign(this->window, -1);
+
+	this->ring.reset(new UnpackBuffer(this->frameSize * this->capacity));
+	this->fences.assign(this->capacity, 0);
+	this->ringFrame.assign(this->capacity, -1);
+
+	if (this->isOpen())
+		this->producer = std::thread(&VideoHeightmapStream::produce, this);
+}
+
+VideoHeightmapStream::~VideoHeightmapStream()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->space.notify_all();
+	if (this->producer.joinable())
+		this->producer.join();
+	for (GLsync fence : this->fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+	}
+	this->ring.reset();
+	delete this->texture;
+}
+
+bool VideoHeightmapStream::isResident(long long frame) const
+{
+	return this->slotFrame[wrap(frame, this->window)] == frame;
+}
+
+//producer thread
+void VideoHeightmapStream::produce()
+{
+	cv::Mat frame, gray;
+	long long next = 0;
+	while (true)
+	{
+		int slot, generation;
+		bool seek = false;
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			if (this->count == this->capacity && !this->stopping && this->seekTo < 0)
+			{
+				this->counters.waits++;
+				this->space.wait(lock, [this]() { return this->stopping || this->count < this->capacity || this->seekTo >= 0; });
+			}
+			if (this->stopping)
+				return;
+			if (this->seekTo >= 0)
+			{
+				next = this->seekTo;
+				this->seekTo = -1;
+				seek = true;
+			}
+			slot = (this->head + this->count) % this->capacity;
+			generation = this->generation;
+		}
+
+		if (seek)
+			this->capture.set(cv::CAP_PROP_POS_FRAMES, (double)wrap(next, this->frameCount));
+		//the sequence loops, the global frame keeps counting up
+		if (!this->capture.read(frame))
+		{
+			this->capture.set(cv::CAP_PROP_POS_FRAMES, 0.0);
+			this->capture.read(frame);
+		}
+
+		unsigned char* pixels = this->ring->data() + slot * this->frameSize;
+		if (frame.empty())
+		{
+			//flat water rather than whatever the slot held before
+			memset(pixels, 128, this->frameSize);
+		}
+		else
+		{
+			if (frame.channels() != 1)
+				cv::cvtColor(frame, gray, (frame.channels() == 4) ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+			else
+				gray = frame;
+			if (gray.cols != this->width || gray.rows != this->height)
+				cv::resize(gray, gray, cv::Size(this->width, this->height));
+			for (int y = 0; y < this->height; y++)
+				memcpy(pixels + (size_t)y * this->width, gray.ptr<unsigned char>(y), this->width);
+		}
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (generation == this->generation)
+		{
+			this->ringFrame[slot] = next;
+			this->count++;
+			this->expected = next + 1;
+			this->counters.decoded++;
+		}
+		next++;
+	}
+}
+
+void VideoHeightmapStream::update(float cursor)
+{
+	if (!this->isOpen())
+		return;
+	long long current = (long long)std::floor(cursor);
+
+	//take the frames the window reaches, the ring is in decode order so the first one
+	//beyond the window ends it, its slice still holds a frame that is going to be shown.
+	//The slots stay published, so the producer leaves them alone while they are copied
+	std::unique_lock<std::mutex> lock(this->mutex);
+	int first = this->uploaded, last = this->uploaded;
+	while (last < this->count && this->ringFrame[(this->head + last) % this->capacity] < current + this->window)
+		last++;
+	lock.unlock();
+
+	int dropped = 0, uploads = 0;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int i = first; i < last; i++)
+	{
+		int index = (this->head + i) % this->capacity;
+		long long frame = this->ringFrame[index];
+		if (frame < current)
+		{
+			dropped++;
+			continue;
+		}
+		int slot = (int)wrap(frame, this->window);
+		this->fences[index] = this->ring->upload(this->texture, slot, this->ring->data() + index * this->frameSize);
+		this->slotFrame[slot] = frame;
+		uploads++;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	//slots the GPU finished copying from go back to the producer, in ring order
+	int retired = 0;
+	for (; retired < last; retired++)
+	{
+		GLsync& fence = this->fences[(this->head + retired) % this->capacity];
+		if (fence)
+		{
+			GLenum result = glClientWaitSync(fence, 0, 0);
+			if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+				break;
+			glDeleteSync(fence);
+			fence = 0;
+		}
+	}
+
+	lock.lock();
+	this->counters.dropped += dropped;
+	this->counters.uploads += uploads;
+	this->head = (this->head + retired) % this->capacity;
+	this->count -= retired;
+	this->uploaded = last - retired;
+	int popped = retired;
+
+	if (!this->isResident(current) || !this->isResident(current + 1))
+		this->counters.late++;
+
+	//a frame behind the decode never comes again, and catching up from far behind would only
+	//decode frames to drop them, both restart the decode at the cursor. Slots still being
+	//copied from stay in the ring until their fence passed
+	if (!this->isResident(current) && this->seekTo < 0 &&
+		(this->expected > current || current - this->expected > this->window))
+	{
+		if (current > this->expected)
+			this->counters.dropped += current - this->expected;
+		this->seekTo = current;
+		this->expected = current;
+		this->generation++;
+		this->count = this->uploaded;
+		this->counters.seeks++;
+		popped++;
+	}
+	lock.unlock();
+	if (popped > 0)
+		this->space.notify_one();
+	this->updates++;
+}
+
+VideoHeightmapStream::Counters VideoHeightmapStream::getCounters()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->counters;
+}
+
+void VideoHeightmapStream::report(int every)
+{
+	if (this->updates < every)
+		return;
+	Counters now = this->getCounters();
+	std::cout << "Heightmap video " << this->window << "/" << this->frameCount << " frames:"
+		<< " decoded " << now.decoded - this->reported.decoded << ","
+		<< " uploads " << now.uploads - this->reported.uploads << ","
+		<< " dropped " << now.dropped - this->reported.dropped << ","
+		<< " late " << now.late - this->reported.late << ","
+		<< " full ring waits " << now.waits - this->reported.waits << ","
+		<< " seeks " << now.seeks - this->reported.seeks << std::endl;
+	this->reported = now;
+	this->updates = 0;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <glad/glad.h>
+#include <opencv2\opencv.hpp>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HeightmapStream.h"
+#include "RenderUtilities/Texture3D.h"
+
+//Heightmap sequence read from one grayscale video instead of a PNG per frame.
+//A producer thread decodes the file front to back into a small ring of frames and waits
+//while the ring is full, the GL thread copies the frames the cursor reaches into the same
+//window layout HeightmapStream uses (global frame g in slice g % window), so the shader
+//samples it the same way. The ring lives in an UnpackBuffer, a slot is only handed back to
+//the producer once the fenced copy out of it finished. Frames the cursor passed before they
+//were uploaded are dropped, jumps the sequential decode can't catch up with (rewinds,
+//long skips) seek the file
+class VideoHeightmapStream
+{
+public:
+	VideoHeightmapStream(const std::string& path, int window = 16, int capacity = 8);
+	~VideoHeightmapStream();
+
+	//false if the file could not be opened, the texture then stays flat
+	bool isOpen() const { return this->frameCount > 0; }
+
+	//GL thread, cursor is the frame being shown (time * rate), it is not wrapped
+	void update(float cursor);
+
+	Texture3D* getTexture() { return this->texture; }
+	int getWindow() const { return this->window; }
+	int getFrameCount() const { return this->frameCount; }
+
+	//decoded counts frames the producer finished, waits how often it blocked on a full ring
+	//(back-pressure, decode is ahead), dropped frames decoded or skipped but never shown,
+	//and late the updates where a frame the shader blends was not uploaded yet
+	struct Counters
+	{
+		long long decoded = 0;
+		long long uploads = 0;
+		long long dropped = 0;
+		long long late = 0;
+		long long waits = 0;
+		long long seeks = 0;
+	};
+	Counters getCounters();
+	//print the counters every few updates
+	void report(int every = 120);
+
+private:
+	void produce();
+	bool isResident(long long frame) const;
+
+	int window;
+	int capacity;
+	int width = 1;
+	int height = 1;
+	int frameCount = 0;
+	size_t frameSize = 1;
+
+	Texture3D* texture = nullptr;
+	std::vector<long long> slotFrame;	//global frame held by every slice, -1 when empty
+
+	//only the producer touches the capture after the constructor
+	cv::VideoCapture capture;
+
+	//the ring pixels, a published slot is only read by the GL thread until it is popped
+	std::unique_ptr<UnpackBuffer> ring;
+	//GL thread only, the copy out of every ring slot, 0 once it is done
+	std::vector<GLsync> fences;
+
+	//everything below is guarded by the mutex, except the pixels of a ring slot
+	//the producer is still writing, which is not published yet
+	std::mutex mutex;
+	std::condition_variable space;
+	std::vector<long long> ringFrame;
+	int head = 0;
+	int count = 0;
+	int uploaded = 0;			//published slots from head on the GL thread is done with, popped once their fence passed
+	long long expected = 0;		//the next frame the producer will publish
+	long long seekTo = -1;
+	int generation = 0;			//bumped by a seek, decodes started before it are thrown away
+	bool stopping = false;
+	Counters counters;
+	Counters reported;
+	int updates = 0;
+
+	std::thread producer;
+};
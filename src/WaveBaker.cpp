@@ -0,0 +1,328 @@
+//Offline baker for the "Height Map" wave mode: animates an OceanFFT spectrum over one
+//repeat period and writes the frames in the formats the viewer reads, so sea states can
+//be tuned here instead of hand making images. The spectrum is tileable in space, and with
+//the frequencies quantized to the period the last frame runs straight into the first.
+//
+//usage: WaveBaker [options] <output directory>
+//  --resolution N   texels per side, power of two (512)
+//  --frames N       frames in one loop (200)
+//  --period S       seconds of ocean time the loop covers (10)
+//  --patch M        meters covered by one tile (200)
+//  --wind S         wind speed in m/s (20)
+//  --direction X Y  wind direction (1 -1)
+//  --jonswap        JONSWAP instead of the Phillips spectrum
+//  --fetch M        JONSWAP fetch in meters (100000)
+//  --seed N         random seed of the spectrum (1)
+//  --threads N      frames baked at the same time (all cores)
+//  --pack FILE      write a TexturePack with "waves" and "wavesSlope" instead of images
+//images go to the output directory as 000.png upwards, point it at ../../Images/waves to
+//replace the sequence the viewer loads. Only the pack carries the precomputed normals, as
+//slopes the viewer scales by the amplitude and wavelength sliders like the FFT ocean's
+
+#include <opencv2\opencv.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/core/utils/filesystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/packing.hpp>
+
+#include "OceanFFT.h"
+#include "TexturePack.h"
+#include "Utilities/ThreadPool.h"
+
+namespace
+{
+	struct Options
+	{
+		OceanFFT::Settings ocean;
+		int frames = 200;
+		int threads = (int)std::thread::hardware_concurrency();
+		std::string output;
+		std::string pack;
+	};
+
+	//one baked frame, heights as the viewer samples them (0.5 is still water), slopes as two halfs
+	struct Frame
+	{
+		std::vector<unsigned char> heights;
+		std::vector<uint32_t> slopes;
+	};
+
+	double elapsedMs(std::chrono::high_resolution_clock::time_point since)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - since).count();
+	}
+
+	bool parse(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+			if (arg == "--jonswap")
+				options.ocean.spectrum = OceanFFT::JONSWAP;
+			else if (arg == "--resolution" && hasValue)
+				options.ocean.resolution = atoi(argv[++i]);
+			else if (arg == "--frames" && hasValue)
+				options.frames = atoi(argv[++i]);
+			else if (arg == "--period" && hasValue)
+				options.ocean.repeatPeriod = (float)atof(argv[++i]);
+			else if (arg == "--patch" && hasValue)
+				options.ocean.patchSize = (float)atof(argv[++i]);
+			else if (arg == "--wind" && hasValue)
+				options.ocean.windSpeed = (float)atof(argv[++i]);
+			else if (arg == "--direction" && i + 2 < argc)
+			{
+				options.ocean.windDirection.x = (float)atof(argv[++i]);
+				options.ocean.windDirection.y = (float)atof(argv[++i]);
+			}
+			else if (arg == "--fetch" && hasValue)
+				options.ocean.fetch = (float)atof(argv[++i]);
+			else if (arg == "--seed" && hasValue)
+				options.ocean.seed = (unsigned int)atoi(argv[++i]);
+			else if (arg == "--threads" && hasValue)
+				options.threads = atoi(argv[++i]);
+			else if (arg == "--pack" && hasValue)
+				options.pack = argv[++i];
+			else if (arg.compare(0, 2, "--") != 0)
+				options.output = arg;
+			else
+			{
+				printf("WaveBaker: unknown option %s\n", arg.c_str());
+				return false;
+			}
+		}
+		if (options.output.empty() && options.pack.empty())
+		{
+			printf("WaveBaker: give an output directory or --pack\n");
+			return false;
+		}
+		int n = options.ocean.resolution;
+		if (n < 16 || (n & (n - 1)) != 0)
+		{
+			printf("WaveBaker: the resolution has to be a power of two\n");
+			return false;
+		}
+		if (options.frames < 1 || options.ocean.repeatPeriod <= 0.0f)
+		{
+			printf("WaveBaker: need at least one frame and a period above zero\n");
+			return false;
+		}
+		options.threads = std::max(options.threads, 1);
+		return true;
+	}
+
+	//rg = slope per tile, b = height in [-1,1], see OceanFFT. The slopes stay per tile, the
+	//viewer scales them like the ocean tile's in getHeightMapNormal
+	void convert(const float* heightSlope, int n, Frame& frame)
+	{
+		frame.heights.resize((size_t)n * n);
+		frame.slopes.resize((size_t)n * n);
+		for (int i = 0; i < n * n; i++)
+		{
+			const float* texel = heightSlope + i * 4;
+			float height = std::min(std::max(texel[2] * 0.5f + 0.5f, 0.0f), 1.0f);
+			frame.heights[i] = (unsigned char)(height * 255.0f + 0.5f);
+			frame.slopes[i] = glm::packHalf2x16(glm::vec2(texel[0], texel[1]));
+		}
+	}
+
+	bool writeImages(const Options& options, int index, Frame& frame)
+	{
+		int n = options.ocean.resolution;
+		std::stringstream name;
+		name << std::setw(3) << std::setfill('0') << index << ".png";
+		cv::Mat heights(n, n, CV_8UC1, frame.heights.data());
+		return cv::imwrite(options.output + "/" + name.str(), heights);
+	}
+
+	//frames are written where they belong as they finish, the pack can be larger than memory
+	class PackWriter
+	{
+	public:
+		PackWriter(const std::string& path, int n, int frames)
+		{
+			const char* names[2] = { "waves", "wavesSlope" };
+			const uint32_t formats[2] = { GL_RED, GL_RG };
+			const uint32_t internalFormats[2] = { GL_R8, GL_RG16F };
+			const uint32_t types[2] = { GL_UNSIGNED_BYTE, GL_HALF_FLOAT };
+			const int texelBytes[2] = { 1, 4 };
+
+			uint64_t offset = sizeof(TexturePack::Header) + 2 * sizeof(TexturePack::Entry);
+			for (int i = 0; i < 2; i++)
+			{
+				TexturePack::Entry& entry = this->entries[i];
+				memset(&entry, 0, sizeof(entry));
+				strncpy(entry.name, names[i], sizeof(entry.name) - 1);
+				entry.target = GL_TEXTURE_3D;
+				entry.internalFormat = internalFormats[i];
+				entry.format = formats[i];
+				entry.type = types[i];
+				entry.width = n;
+				entry.height = n;
+				entry.depth = frames;
+				//mips of a stack this size are better left to TexturePacker from the images
+				entry.levels = 1;
+				offset = (offset + 15) & ~(uint64_t)15;
+				entry.offset[0] = offset;
+				entry.size[0] = (uint64_t)n * n * texelBytes[i] * frames;
+				offset += entry.size[0];
+			}
+
+			this->file = fopen(path.c_str(), "wb");
+			if (!this->file)
+				return;
+			TexturePack::Header header;
+			memcpy(header.magic, "TPAK", 4);
+			header.version = TexturePack::VERSION;
+			header.count = 2;
+			header.reserved = 0;
+			fwrite(&header, sizeof(header), 1, this->file);
+			fwrite(this->entries, sizeof(TexturePack::Entry), 2, this->file);
+		}
+		~PackWriter()
+		{
+			if (this->file)
+				fclose(this->file);
+		}
+		bool isOpen() const { return this->file != nullptr; }
+
+		bool write(int index, const Frame& frame)
+		{
+			const void* layers[2] = { frame.heights.data(), frame.slopes.data() };
+			const size_t sizes[2] = { frame.heights.size(), frame.slopes.size() * sizeof(uint32_t) };
+			for (int i = 0; i < 2; i++)
+			{
+				uint64_t position = this->entries[i].offset[0] + (uint64_t)index * sizes[i];
+				if (!seek(position) || fwrite(layers[i], 1, sizes[i], this->file) != sizes[i])
+					return false;
+			}
+			return true;
+		}
+
+	private:
+		bool seek(uint64_t position)
+		{
+#ifdef _WIN32
+			return _fseeki64(this->file, (long long)position, SEEK_SET) == 0;
+#else
+			return fseeko(this->file, (off_t)position, SEEK_SET) == 0;
+#endif
+		}
+
+		FILE* file = nullptr;
+		TexturePack::Entry entries[2];
+	};
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	options.ocean.repeatPeriod = 10.0f;
+	if (!parse(argc, argv, options))
+		return 1;
+	const int n = options.ocean.resolution;
+	const int frames = options.frames;
+	const float period = options.ocean.repeatPeriod;
+
+	std::unique_ptr<PackWriter> pack;
+	if (!options.pack.empty())
+	{
+		pack.reset(new PackWriter(options.pack, n, frames));
+		if (!pack->isOpen())
+		{
+			printf("WaveBaker: could not write %s\n", options.pack.c_str());
+			return 1;
+		}
+	}
+	else
+	{
+		//imwrite does not make directories
+		cv::utils::fs::createDirectories(options.output);
+	}
+
+	//one ocean per thread, each runs its transforms serially so whole frames go in parallel
+	auto start = std::chrono::high_resolution_clock::now();
+	int threads = std::min(options.threads, frames);
+	std::vector<std::unique_ptr<OceanFFT>> oceans;
+	for (int i = 0; i < threads; i++)
+		oceans.emplace_back(new OceanFFT(options.ocean, nullptr));
+	std::vector<Frame> batch(threads);
+	printf("WaveBaker: %d frames at %dx%d over %.2f s on %d threads, spectrum %.0f ms\n",
+		frames, n, n, period, threads, elapsedMs(start));
+
+	//the pool's workers plus the calling thread make one band per ocean
+	ThreadPool pool(std::max(threads - 1, 1));
+	bool ok = true;
+	double frameMs = 0.0, writeMs = 0.0;
+	start = std::chrono::high_resolution_clock::now();
+	for (int first = 0; first < frames && ok; first += threads)
+	{
+		std::vector<double> bandMs(threads, 0.0);
+		std::vector<char> written(threads, 1);
+		pool.parallelFor(0, threads, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				int index = first + i;
+				if (index >= frames)
+					continue;
+				auto frameStart = std::chrono::high_resolution_clock::now();
+				//frames / period apart, so frame `frames` would be frame 0 again
+				oceans[i]->update(period * index / frames);
+				convert(oceans[i]->getHeightSlope(), n, batch[i]);
+				if (!pack)
+					written[i] = writeImages(options, index, batch[i]);
+				bandMs[i] = elapsedMs(frameStart);
+			}
+		});
+		for (int i = 0; i < threads; i++)
+		{
+			frameMs += bandMs[i];
+			ok = ok && written[i];
+		}
+		if (pack)
+		{
+			auto writeStart = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < threads && first + i < frames && ok; i++)
+				ok = pack->write(first + i, batch[i]);
+			writeMs += elapsedMs(writeStart);
+		}
+		if ((first / threads) % 10 == 0)
+			printf("WaveBaker: %d/%d\n", std::min(first + threads, frames), frames);
+	}
+	double wallMs = elapsedMs(start);
+	if (!ok)
+	{
+		printf("WaveBaker: could not write %s\n", pack ? options.pack.c_str() : options.output.c_str());
+		return 1;
+	}
+
+	//the seam: one period on has to give frame 0 back
+	Frame loop;
+	oceans[0]->update(period);
+	convert(oceans[0]->getHeightSlope(), n, loop);
+	oceans[0]->update(0.0f);
+	convert(oceans[0]->getHeightSlope(), n, batch[0]);
+	int seam = 0;
+	for (int i = 0; i < n * n; i++)
+		seam = std::max(seam, std::abs((int)loop.heights[i] - (int)batch[0].heights[i]));
+
+	printf("WaveBaker: %.1f s, %.1f frames/s, %.1f ms per frame", wallMs / 1000.0, frames * 1000.0 / wallMs, frameMs / frames);
+	if (pack)
+		printf(", %.1f ms writing", writeMs);
+	printf(", loop seam %d/255\n", seam);
+	return 0;
+}
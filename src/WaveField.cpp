@@ -0,0 +1,384 @@
+#include "WaveField.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/type_ptr.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WAVE_FIELD_SSE
+#endif
+
+namespace
+{
+	//the constants of waveFunctions.glsl, the sine model really uses 3.14
+	const float SINE_TWO_PI = 2.0f * 3.14f;
+	const float RIPPLE_TWO_PI = 2.0f * 3.1415926f;
+	//the heightmap style normals, normalize(-dh/du, NORMAL_SCALE, dh/dv)
+	const float NORMAL_SCALE = 200.0f;
+
+	glm::vec3 slopeNormal(const glm::vec2& slope)
+	{
+		return glm::normalize(glm::vec3(-slope.x, NORMAL_SCALE, slope.y));
+	}
+
+	//GL_LINEAR lookup, repeating or clamped to the edge
+	glm::vec4 sample(const WaveField::Grid& grid, const glm::vec2& uv, bool repeat)
+	{
+		const int n = grid.resolution;
+		glm::vec2 texel = uv * (float)n - 0.5f;
+		glm::vec2 base = glm::floor(texel);
+		glm::vec2 f = texel - base;
+		int x[2] = { (int)base.x, (int)base.x + 1 };
+		int y[2] = { (int)base.y, (int)base.y + 1 };
+		for (int i = 0; i < 2; i++)
+		{
+			if (repeat)
+			{
+				x[i] = ((x[i] % n) + n) % n;
+				y[i] = ((y[i] % n) + n) % n;
+			}
+			else
+			{
+				x[i] = glm::clamp(x[i], 0, n - 1);
+				y[i] = glm::clamp(y[i], 0, n - 1);
+			}
+		}
+		auto at = [&](int i, int j) { return glm::make_vec4(grid.heightSlope + (y[j] * n + x[i]) * 4); };
+		return glm::mix(glm::mix(at(0, 0), at(1, 0), f.x), glm::mix(at(0, 1), at(1, 1), f.x), f.y);
+	}
+
+#if defined(WAVE_FIELD_SSE)
+	//sine and cosine of four values: reduce by pi/2 in three parts, then the minimax
+	//polynomials of the single precision C libraries on [-pi/4, pi/4]
+	inline void sincos4(__m128 x, __m128& s, __m128& c)
+	{
+		__m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.636619772f)));
+		__m128 q = _mm_cvtepi32_ps(quadrant);
+		__m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(1.5703125f)));
+		r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(4.837512969970703125e-4f)));
+		r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(7.54978995489188216e-8f)));
+		__m128 r2 = _mm_mul_ps(r, r);
+
+		__m128 sr = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(-1.9515295891e-4f)), _mm_set1_ps(8.3321608736e-3f));
+		sr = _mm_add_ps(_mm_mul_ps(sr, r2), _mm_set1_ps(-1.6666654611e-1f));
+		sr = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sr, r2), r), r);
+		__m128 cr = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(2.443315711809948e-5f)), _mm_set1_ps(-1.388731625493765e-3f));
+		cr = _mm_add_ps(_mm_mul_ps(cr, r2), _mm_set1_ps(4.166664568298827e-2f));
+		cr = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_mul_ps(cr, r2), r2), _mm_mul_ps(r2, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+		//odd quadrants swap the two, quadrants 2 and 3 negate the sine, 1 and 2 the cosine
+		__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+		__m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+		__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+		s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, cr), _mm_andnot_ps(swap, sr)), sinSign);
+		c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, sr), _mm_andnot_ps(swap, cr)), cosSign);
+	}
+
+	//x and z of four positions
+	inline void load4(const glm::vec2* positions, __m128& x, __m128& z)
+	{
+		__m128 a = _mm_loadu_ps(&positions[0].x);
+		__m128 b = _mm_loadu_ps(&positions[2].x);
+		x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		z = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+	}
+
+	inline void storeNormals(glm::vec3* normals, __m128 x, __m128 y, __m128 z)
+	{
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+		float nx[4], ny[4], nz[4];
+		_mm_storeu_ps(nx, _mm_div_ps(x, length));
+		_mm_storeu_ps(ny, _mm_div_ps(y, length));
+		_mm_storeu_ps(nz, _mm_div_ps(z, length));
+		for (int i = 0; i < 4; i++)
+			normals[i] = glm::vec3(nx[i], ny[i], nz[i]);
+	}
+#endif
+}
+
+WaveField::WaveField(ThreadPool* pool) :
+	pool(pool)
+{
+}
+
+bool WaveField::needsReadback() const
+{
+	const Parameters& p = this->parameters;
+	return (p.waveSelect == 1 && !p.useOcean) || (p.waveSelect == 2 && p.useSolver && !this->solver.heightSlope);
+}
+
+bool WaveField::isAvailable() const
+{
+	const Parameters& p = this->parameters;
+	if (this->needsReadback())
+		return this->readback.heightSlope != nullptr;
+	if (p.waveSelect == 1)
+		return p.useOcean && this->ocean.heightSlope;
+	if (p.waveSelect == 2)
+		return p.useSolver ? this->solver.heightSlope != nullptr : (this->drops && this->dropBins);
+	if (p.waveSelect == 3)
+		return this->waveSet != nullptr;
+	return true;
+}
+
+float WaveField::bound() const
+{
+	const Parameters& p = this->parameters;
+	auto gridBound = [&](const Grid& grid)
+	{
+		float highest = 0.0f;
+		for (int i = 0; i < grid.resolution * grid.resolution; i++)
+			highest = std::max(highest, std::abs(grid.heightSlope[i * 4 + 2]));
+		return std::abs(p.amplitude) * highest;
+	};
+	if (!this->isAvailable())
+		return 0.0f;
+	if (this->needsReadback())
+	{
+		float highest = 0.0f;
+		for (int i = 0; i < this->readback.resolution * this->readback.resolution; i++)
+			highest = std::max(highest, std::abs(this->readback.heightSlope[i * 4 + 3]));
+		return highest;
+	}
+	if (p.waveSelect == 1)
+		return gridBound(this->ocean);
+	if (p.waveSelect == 2 && p.useSolver)
+		return gridBound(this->solver);
+	if (p.waveSelect == 2)
+	{
+		//|sin| <= 1 and the exponential is at least 1
+		float sum = 0.0f;
+		for (int i = 0; i < this->drops->size(); i++)
+			sum += std::abs(this->drops->at(i).amplitude);
+		return std::abs(p.amplitude) * 1.5f * sum;
+	}
+	if (p.waveSelect == 3)
+	{
+		float sum = 0.0f;
+		for (const WaveSet::Wave& wave : this->waveSet->waves)
+			sum += std::abs(wave.amplitude);
+		return sum;
+	}
+	return std::abs(p.amplitude);
+}
+
+float WaveField::horizontalBound() const
+{
+	if (this->parameters.waveSelect != 3 || !this->waveSet)
+		return 0.0f;
+	//a crest moves by steepness * amplitude, which WaveSet makes depend on the wavelength and not on the height
+	float sum = 0.0f;
+	for (const WaveSet::Wave& wave : this->waveSet->waves)
+		sum += std::abs(wave.steepness * wave.amplitude);
+	return sum;
+}
+
+void WaveField::gerstnerWaves(std::vector<GerstnerWave>& waves) const
+{
+	waves.clear();
+	if (this->parameters.waveSelect != 3 || !this->waveSet)
+		return;
+	int count = std::min((int)this->waveSet->waves.size(), (int)WaveSet::MAX_WAVES);
+	for (int i = 0; i < count; i++)
+	{
+		const WaveSet::Wave& wave = this->waveSet->waves[i];
+		float k = 2.0f * 3.14159265358979f / wave.wavelength;
+		GerstnerWave gpu;
+		gpu.directionFrequency = glm::vec4(glm::normalize(wave.direction), k, std::sqrt(this->waveSet->gravity * k));
+		gpu.amplitudeSteepnessPhase = glm::vec3(wave.amplitude, wave.steepness, wave.phase);
+		waves.push_back(gpu);
+	}
+}
+
+float WaveField::height(const glm::vec2& position) const
+{
+	float height;
+	this->query(&position, 1, &height);
+	return height;
+}
+
+void WaveField::query(const glm::vec2* positions, int count, float* heights, glm::vec3* normals) const
+{
+	std::vector<GerstnerWave> waves;
+	this->gerstnerWaves(waves);
+	if (!this->pool || count < this->parallelThreshold)
+	{
+		this->queryRange(positions, count, heights, normals, waves);
+		return;
+	}
+	this->pool->parallelFor(0, count, [&](int begin, int end)
+	{
+		this->queryRange(positions + begin, end - begin, heights + begin, normals ? normals + begin : nullptr, waves);
+	});
+}
+
+void WaveField::queryRange(const glm::vec2* positions, int count, float* heights, glm::vec3* normals, const std::vector<GerstnerWave>& waves) const
+{
+	int done = 0;
+	if (this->simd && this->isAvailable())
+	{
+		if (this->parameters.waveSelect == 0)
+			done = this->sineBatch(positions, count, heights, normals);
+		else if (this->parameters.waveSelect == 3)
+			done = this->gerstnerBatch(positions, count, heights, normals, waves);
+	}
+	glm::vec3 normal;
+	for (int i = done; i < count; i++)
+	{
+		heights[i] = this->evaluate(positions[i], normal, waves);
+		if (normals)
+			normals[i] = normal;
+	}
+}
+
+float WaveField::evaluate(const glm::vec2& position, glm::vec3& normal, const std::vector<GerstnerWave>& waves) const
+{
+	const Parameters& p = this->parameters;
+	//the surface texture coordinate, v runs against z as forSurface.vert flips it
+	glm::vec2 uv = glm::vec2(position.x, -position.y) / (2.0f * this->halfSize) + 0.5f;
+	normal = glm::vec3(0, 1, 0);
+	if (!this->isAvailable())
+		return 0.0f;
+
+	if (this->needsReadback())
+	{
+		glm::vec4 texel = sample(this->readback, uv, false);
+		normal = glm::normalize(glm::vec3(texel));
+		return texel.w;
+	}
+	if (p.waveSelect == 2 && p.useSolver)
+	{
+		glm::vec4 texel = sample(this->solver, uv, false);
+		normal = slopeNormal(p.amplitude * glm::vec2(texel));
+		return p.amplitude * texel.z;
+	}
+	if (p.waveSelect == 2)
+	{
+		//getSimCoord over the drops of the cell, differentiated along the distance
+		const int n = this->dropBins->getGridSize();
+		glm::ivec2 cell = glm::clamp(glm::ivec2(uv * (float)n), glm::ivec2(0), glm::ivec2(n - 1));
+		glm::ivec2 range = this->dropBins->getCells()[cell.y * n + cell.x];
+		const std::vector<int>& indices = this->dropBins->getIndices();
+		float height = 0.0f;
+		glm::vec2 slope(0.0f);
+		for (int i = range.x; i < range.x + range.y; i++)
+		{
+			const DropRing::Drop& drop = this->drops->inSlot(indices[i]);
+			glm::vec2 offset = uv - drop.position;
+			float length = glm::length(offset);
+			float dist = length / p.wavelength * 30.0f;
+			float tc = (p.time - drop.startTime) * RIPPLE_TWO_PI * 5.0f;
+			float ramp = glm::clamp(0.0125f * tc, 0.0f, 1.0f);
+			float ring = dist - tc;
+			float scale = p.amplitude * drop.amplitude * 1.5f / std::exp(0.1f * std::abs(ring) + 0.05f * tc);
+			float s = std::sin(ring * ramp);
+			height += scale * s;
+			if (length > 0.0f)
+			{
+				float dDist = scale * (ramp * std::cos(ring * ramp) - 0.1f * (ring < 0.0f ? -1.0f : 1.0f) * s);
+				slope += dDist * 30.0f / p.wavelength * offset / length;
+			}
+		}
+		normal = slopeNormal(slope);
+		return height;
+	}
+	if (p.waveSelect == 3)
+	{
+		float height = 0.0f;
+		normal = glm::vec3(0, 1, 0);
+		for (const GerstnerWave& wave : waves)
+		{
+			glm::vec2 direction = glm::vec2(wave.directionFrequency);
+			float k = wave.directionFrequency.z;
+			float amplitude = wave.amplitudeSteepnessPhase.x;
+			float theta = k * glm::dot(direction, position) - wave.directionFrequency.w * p.time + wave.amplitudeSteepnessPhase.z;
+			float s = std::sin(theta);
+			float c = std::cos(theta);
+			height += amplitude * s;
+			float ka = k * amplitude;
+			normal.x -= direction.x * ka * c;
+			normal.z -= direction.y * ka * c;
+			normal.y -= wave.amplitudeSteepnessPhase.y * ka * s;
+		}
+		normal = glm::normalize(normal);
+		return height;
+	}
+	if (p.waveSelect == 1)
+	{
+		float tile = p.wavelength * 8.0f;
+		glm::vec4 texel = sample(this->ocean, uv / tile, true);
+		normal = slopeNormal(p.amplitude * glm::vec2(texel) / tile);
+		return p.amplitude * texel.z;
+	}
+	float k = SINE_TWO_PI / p.wavelength;
+	float phase = k * (glm::dot(p.direction, uv) + p.time);
+	normal = slopeNormal(p.amplitude * k * std::cos(phase) * p.direction);
+	return p.amplitude * std::sin(phase);
+}
+
+int WaveField::sineBatch(const glm::vec2* positions, int count, float* heights, glm::vec3* normals) const
+{
+#if defined(WAVE_FIELD_SSE)
+	const Parameters& p = this->parameters;
+	float k = SINE_TWO_PI / p.wavelength;
+	//phase = k * (d . uv + t) with uv = (x, -z) / size + 0.5, folded into one multiply-add per axis
+	float toUV = 1.0f / (2.0f * this->halfSize);
+	const __m128 kx = _mm_set1_ps(k * p.direction.x * toUV);
+	const __m128 kz = _mm_set1_ps(-k * p.direction.y * toUV);
+	const __m128 k0 = _mm_set1_ps(k * (0.5f * (p.direction.x + p.direction.y) + p.time));
+	const __m128 amplitude = _mm_set1_ps(p.amplitude);
+	const __m128 slopeX = _mm_set1_ps(-p.amplitude * k * p.direction.x);
+	const __m128 slopeZ = _mm_set1_ps(p.amplitude * k * p.direction.y);
+	const __m128 up = _mm_set1_ps(NORMAL_SCALE);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x, z, s, c;
+		load4(positions + i, x, z);
+		sincos4(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, kx), _mm_mul_ps(z, kz)), k0), s, c);
+		_mm_storeu_ps(heights + i, _mm_mul_ps(amplitude, s));
+		if (normals)
+			storeNormals(normals + i, _mm_mul_ps(slopeX, c), up, _mm_mul_ps(slopeZ, c));
+	}
+	return i;
+#else
+	return 0;
+#endif
+}
+
+int WaveField::gerstnerBatch(const glm::vec2* positions, int count, float* heights, glm::vec3* normals, const std::vector<GerstnerWave>& waves) const
+{
+#if defined(WAVE_FIELD_SSE)
+	const float time = this->parameters.time;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x, z;
+		load4(positions + i, x, z);
+		__m128 height = _mm_setzero_ps();
+		__m128 nx = _mm_setzero_ps(), ny = _mm_set1_ps(1.0f), nz = _mm_setzero_ps();
+		for (const GerstnerWave& wave : waves)
+		{
+			float k = wave.directionFrequency.z;
+			float amplitude = wave.amplitudeSteepnessPhase.x;
+			float ka = k * amplitude;
+			__m128 theta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(k * wave.directionFrequency.x)),
+				_mm_mul_ps(z, _mm_set1_ps(k * wave.directionFrequency.y))),
+				_mm_set1_ps(wave.amplitudeSteepnessPhase.z - wave.directionFrequency.w * time));
+			__m128 s, c;
+			sincos4(theta, s, c);
+			height = _mm_add_ps(height, _mm_mul_ps(_mm_set1_ps(amplitude), s));
+			nx = _mm_sub_ps(nx, _mm_mul_ps(_mm_set1_ps(wave.directionFrequency.x * ka), c));
+			nz = _mm_sub_ps(nz, _mm_mul_ps(_mm_set1_ps(wave.directionFrequency.y * ka), c));
+			ny = _mm_sub_ps(ny, _mm_mul_ps(_mm_set1_ps(wave.amplitudeSteepnessPhase.y * ka), s));
+		}
+		_mm_storeu_ps(heights + i, height);
+		if (normals)
+			storeNormals(normals + i, nx, ny, nz);
+	}
+	return i;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "DropBins.h"
+#include "DropRing.h"
+#include "WaveSet.h"
+#include "Utilities/ThreadPool.h"
+
+//CPU copy of evaluateWave in waveFunctions.glsl, for whatever needs the water away from the
+//GPU: picking, floating objects, splashes, sound. A position is a world XZ on the flat surface,
+//the result is the height and normal the tessellation gives the vertex that starts there.
+//Sine and Gerstner run four points at a time with SSE, the texture models are bilinear
+//lookups into the same images the GPU gets, and large batches are split over the pool
+class WaveField
+{
+public:
+	//the inputs setWaveUniforms gives the shader
+	struct Parameters
+	{
+		int waveSelect = 0;			//0 sine, 1 height map, 2 interactive, 3 gerstner
+		float time = 0.0f;
+		float wavelength = 1.0f;
+		float amplitude = 1.0f;
+		glm::vec2 direction = glm::vec2(1, -1);
+		bool useOcean = false;
+		bool useSolver = false;		//interactive mode from the solver image instead of the drops
+	};
+
+	//RGBA float image (dh/du, dh/dv, h, 0) as uploaded to the GPU, nullptr when there is none
+	struct Grid
+	{
+		const float* heightSlope = nullptr;
+		int resolution = 0;
+	};
+
+	WaveField(ThreadPool* pool = &ThreadPool::shared());
+
+	Parameters parameters;
+	//what the models read, owned by the caller and kept current by it
+	const DropRing* drops = nullptr;
+	const DropBins* dropBins = nullptr;
+	const WaveSet* waveSet = nullptr;
+	Grid ocean;
+	Grid solver;
+	//latest HeightReadback copy, (normal.xyz, height) per surface texel, stands in for the
+	//models that only live on the GPU
+	Grid readback;
+
+	//the surface is 2 * halfSize across, texture space covers it once
+	float halfSize = 100.0f;
+	//batches at least this long are split over the pool
+	int parallelThreshold = 16384;
+	//false evaluates every point with the scalar code, for comparisons
+	bool simd = true;
+
+	//heights and, when normals is not null, unit normals at count world XZ positions
+	void query(const glm::vec2* positions, int count, float* heights, glm::vec3* normals = nullptr) const;
+	float height(const glm::vec2& position) const;
+
+	//true when the current model only lives on the GPU (height map images, the GPU solver)
+	//and is answered from readback
+	bool needsReadback() const;
+	//false when there is nothing to answer the current model with, queries then return the
+	//flat surface
+	bool isAvailable() const;
+	//no height of the current model is farther than this from 0
+	float bound() const;
+	//no point of the current model moves farther than this along x or z, only Gerstner waves move sideways
+	float horizontalBound() const;
+
+private:
+	//one Gerstner component as WaveSet uploads it: xy direction, wave number, angular speed,
+	//and amplitude, steepness, phase
+	struct GerstnerWave
+	{
+		glm::vec4 directionFrequency;
+		glm::vec3 amplitudeSteepnessPhase;
+	};
+
+	void gerstnerWaves(std::vector<GerstnerWave>& waves) const;
+	void queryRange(const glm::vec2* positions, int count, float* heights, glm::vec3* normals, const std::vector<GerstnerWave>& waves) const;
+	//one point with the scalar code
+	float evaluate(const glm::vec2& position, glm::vec3& normal, const std::vector<GerstnerWave>& waves) const;
+	//four points at a time, returns how many were done, the rest go through evaluate
+	int sineBatch(const glm::vec2* positions, int count, float* heights, glm::vec3* normals) const;
+	int gerstnerBatch(const glm::vec2* positions, int count, float* heights, glm::vec3* normals, const std::vector<GerstnerWave>& waves) const;
+
+	ThreadPool* pool;
+};
@@ -0,0 +1,189 @@
+//Microbenchmark of the batched CPU wave queries: one frame is a batch of random surface
+//positions answered with heights and normals, timed for every model WaveField mirrors,
+//four wide and scalar, on one thread and over the pool. The SSE results are checked
+//against the scalar ones so a faster path that drifts from the shader shows up here.
+//
+//usage: WaveFieldBench [options]
+//  --points N       positions per frame (1048576)
+//  --frames N       frames timed per configuration (20)
+//  --drops N        live ripples for the interactive model (100)
+//  --threads N      pool size (all cores)
+//  --seed N         random seed of the positions and drops (1)
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DropBins.h"
+#include "DropRing.h"
+#include "OceanFFT.h"
+#include "WaveField.h"
+#include "WaveSet.h"
+#include "WaveSolver.h"
+#include "Utilities/ThreadPool.h"
+
+namespace
+{
+	struct Options
+	{
+		int points = 1 << 20;
+		int frames = 20;
+		int drops = 100;
+		int threads = (int)std::thread::hardware_concurrency();
+		unsigned int seed = 1;
+	};
+
+	double elapsedMs(std::chrono::high_resolution_clock::time_point since)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - since).count();
+	}
+
+	bool parse(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+			if (arg == "--points" && hasValue)
+				options.points = atoi(argv[++i]);
+			else if (arg == "--frames" && hasValue)
+				options.frames = atoi(argv[++i]);
+			else if (arg == "--drops" && hasValue)
+				options.drops = atoi(argv[++i]);
+			else if (arg == "--threads" && hasValue)
+				options.threads = atoi(argv[++i]);
+			else if (arg == "--seed" && hasValue)
+				options.seed = (unsigned int)atoi(argv[++i]);
+			else
+			{
+				printf("WaveFieldBench: unknown option %s\n", arg.c_str());
+				return false;
+			}
+		}
+		if (options.points < 1 || options.frames < 1 || options.drops < 0)
+		{
+			printf("WaveFieldBench: need at least one point and one frame\n");
+			return false;
+		}
+		options.threads = std::max(options.threads, 1);
+		return true;
+	}
+
+	struct Result
+	{
+		double ms = 0.0;
+		std::vector<float> heights;
+		std::vector<glm::vec3> normals;
+	};
+
+	//average of the frames, the time advances so the models do not answer from a warm cache
+	void run(WaveField& field, const std::vector<glm::vec2>& positions, int frames, Result& result)
+	{
+		int count = (int)positions.size();
+		result.heights.resize(count);
+		result.normals.resize(count);
+		float start = field.parameters.time;
+		auto begin = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < frames; i++)
+		{
+			field.parameters.time = start + i * 0.02f;
+			field.query(positions.data(), count, result.heights.data(), result.normals.data());
+		}
+		result.ms = elapsedMs(begin) / frames;
+		field.parameters.time = start;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parse(argc, argv, options))
+		return 1;
+	ThreadPool pool(options.threads);
+	std::mt19937 random(options.seed);
+	std::uniform_real_distribution<float> across(-100.0f, 100.0f), unit(0.0f, 1.0f);
+
+	std::vector<glm::vec2> positions(options.points);
+	for (glm::vec2& position : positions)
+		position = glm::vec2(across(random), across(random));
+
+	//the inputs the viewer would have a few seconds in
+	const float time = 3.0f;
+	WaveSet waveSet;
+	DropRing drops(std::max(options.drops, 1));
+	for (int i = 0; i < options.drops; i++)
+		drops.push(glm::vec2(unit(random), unit(random)), time - unit(random) * 2.0f);
+	DropBins dropBins;
+	dropBins.build(drops, time, 0.3f, 1.0f);
+
+	OceanFFT::Settings oceanSettings;
+	OceanFFT ocean(oceanSettings, &pool);
+	ocean.update(time);
+
+	WaveSolver solver(256, &pool);
+	for (int i = 0; i < 20; i++)
+		solver.addImpulse(glm::vec2(unit(random), unit(random)));
+	for (int i = 0; i < 60; i++)
+		solver.step();
+
+	WaveField field(&pool);
+	field.drops = &drops;
+	field.dropBins = &dropBins;
+	field.waveSet = &waveSet;
+	field.ocean.heightSlope = ocean.getHeightSlope();
+	field.ocean.resolution = ocean.getResolution();
+	field.solver.heightSlope = solver.getHeightSlope();
+	field.solver.resolution = solver.getResolution();
+	field.parameters.time = time;
+	field.parameters.wavelength = 0.3f;
+	field.parameters.amplitude = 1.0f;
+
+	struct Model
+	{
+		const char* name;
+		int waveSelect;
+		bool useOcean;
+		bool useSolver;
+	};
+	const Model models[] = {
+		{ "sine", 0, false, false },
+		{ "gerstner", 3, false, false },
+		{ "ocean", 1, true, false },
+		{ "ripples", 2, false, false },
+		{ "solver", 2, false, true },
+	};
+
+	printf("%d points per frame, %d frames, %d threads\n", options.points, options.frames, options.threads);
+	printf("%-10s %12s %12s %12s %12s %10s %10s\n", "model", "scalar 1t", "simd 1t", "scalar pool", "simd pool", "dh", "dn");
+	for (const Model& model : models)
+	{
+		field.parameters.waveSelect = model.waveSelect;
+		field.parameters.useOcean = model.useOcean;
+		field.parameters.useSolver = model.useSolver;
+
+		Result results[4];
+		for (int i = 0; i < 4; i++)
+		{
+			field.simd = (i & 1) != 0;
+			field.parallelThreshold = i < 2 ? options.points + 1 : 16384;
+			run(field, positions, options.frames, results[i]);
+		}
+
+		//largest difference between the four wide and the scalar answers
+		float dh = 0.0f, dn = 0.0f;
+		for (int i = 0; i < options.points; i++)
+		{
+			dh = std::max(dh, std::abs(results[0].heights[i] - results[1].heights[i]));
+			dn = std::max(dn, glm::length(results[0].normals[i] - results[1].normals[i]));
+		}
+		printf("%-10s %9.2f ms %9.2f ms %9.2f ms %9.2f ms %10.2g %10.2g\n", model.name,
+			results[0].ms, results[1].ms, results[2].ms, results[3].ms, dh, dn);
+	}
+	return 0;
+}
@@ -0,0 +1,96 @@
+#include "WaveSet.h"
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+	const float PI = 3.14159265358979f;
+
+	//std140 layout of the gerstner_waves block in forSurface.tese
+	struct GpuWave
+	{
+		glm::vec4 directionFrequency;		//xy direction, z wave number, w angular speed
+		glm::vec4 amplitudeSteepnessPhase;	//x amplitude, y steepness, z phase
+	};
+	struct GpuWaveBlock
+	{
+		glm::ivec4 count;
+		GpuWave waves[WaveSet::MAX_WAVES];
+	};
+	static_assert(sizeof(GpuWaveBlock) == 16 + WaveSet::MAX_WAVES * 32, "gerstner_waves must match std140");
+}
+
+bool WaveSet::Settings::operator==(const Settings& other) const
+{
+	return this->count == other.count && this->wavelength == other.wavelength &&
+		this->amplitude == other.amplitude && this->steepness == other.steepness &&
+		this->angle == other.angle && this->spread == other.spread && this->seed == other.seed;
+}
+
+WaveSet::WaveSet()
+{
+	this->generate();
+}
+
+void WaveSet::setSettings(const Settings& settings)
+{
+	if (settings == this->settings)
+		return;
+	this->settings = settings;
+	this->generate();
+}
+
+void WaveSet::generate()
+{
+	int count = glm::clamp(this->settings.count, 1, MAX_WAVES);
+	std::mt19937 random(this->settings.seed);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	this->waves.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		Wave& wave = this->waves[i];
+		//the first wave is the median one so a single wave matches the sliders exactly
+		float octave = (i == 0) ? 0.0f : unit(random);
+		float angle = glm::radians(this->settings.angle + ((i == 0) ? 0.0f : unit(random) * this->settings.spread));
+		wave.direction = glm::vec2(std::cos(angle), std::sin(angle));
+		wave.wavelength = this->settings.wavelength * std::exp2(octave);
+		//constant steepness per wave, shared out so the sum stays about the slider amplitude
+		wave.amplitude = this->settings.amplitude * std::exp2(octave) / std::sqrt((float)count);
+		float k = 2.0f * PI / wave.wavelength;
+		wave.steepness = glm::clamp(this->settings.steepness, 0.0f, 1.0f) / glm::max(k * wave.amplitude * count, 1e-6f);
+		wave.phase = (unit(random) + 1.0f) * PI;
+	}
+	this->dirty = true;
+}
+
+void WaveSet::bind(GLuint binding)
+{
+	if (!this->ubo)
+	{
+		glGenBuffers(1, &this->ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, this->ubo);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(GpuWaveBlock), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+	if (this->dirty)
+	{
+		GpuWaveBlock block;
+		int count = glm::min((int)this->waves.size(), MAX_WAVES);
+		block.count = glm::ivec4(count, 0, 0, 0);
+		for (int i = 0; i < count; i++)
+		{
+			const Wave& wave = this->waves[i];
+			float k = 2.0f * PI / wave.wavelength;
+			block.waves[i].directionFrequency = glm::vec4(glm::normalize(wave.direction), k, std::sqrt(this->gravity * k));
+			block.waves[i].amplitudeSteepnessPhase = glm::vec4(wave.amplitude, wave.steepness, wave.phase, 0.0f);
+		}
+		//only the live part of the array is sent
+		glBindBuffer(GL_UNIFORM_BUFFER, this->ubo);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::ivec4) + count * sizeof(GpuWave), &block);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		this->dirty = false;
+	}
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, this->ubo);
+}
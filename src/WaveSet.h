@@ -0,0 +1,59 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+//A set of Gerstner wave components living in a std140 uniform block (binding 1)
+//the shader sums them in one loop for both the displacement and the normal
+class WaveSet
+{
+public:
+	static const int MAX_WAVES = 64;
+
+	struct Wave
+	{
+		glm::vec2 direction;
+		float wavelength;		//world units
+		float amplitude;		//world units
+		float steepness;		//Q, 0 is a plain sine and 1 / (k * A * count) is the sharpest crest without loops
+		float phase;
+	};
+
+	//parameters the random set is generated from, the sliders map onto these
+	struct Settings
+	{
+		int count = 8;
+		float wavelength = 40.0f;	//median wavelength
+		float amplitude = 5.0f;		//amplitude of the median wave when there is only one
+		float steepness = 0.5f;		//0 - 1, spread over all waves
+		float angle = 315.0f;		//main direction in degrees
+		float spread = 60.0f;		//directions are picked in angle +- spread
+		unsigned int seed = 1;
+
+		bool operator==(const Settings& other) const;
+		bool operator!=(const Settings& other) const { return !(*this == other); }
+	};
+
+	WaveSet();
+
+	//regenerates the waves if the settings changed
+	void setSettings(const Settings& settings);
+	const Settings& getSettings() const { return this->settings; }
+
+	//uploads the block if anything changed and binds it, needs a current GL context
+	void bind(GLuint binding = 1);
+
+	//edit single components or gravity directly, markDirty() after changing them
+	std::vector<Wave> waves;
+	void markDirty() { this->dirty = true; }
+
+	//deep water dispersion, the surface is 200 units across so units are treated as decimeters
+	float gravity = 98.1f;
+
+private:
+	void generate();
+
+	Settings settings;
+	bool dirty = true;
+	GLuint ubo = 0;
+};
@@ -0,0 +1,153 @@
+#include "WaveSolver.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define WAVE_SOLVER_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WAVE_SOLVER_SSE
+#endif
+
+WaveSolver::WaveSolver(int resolution, ThreadPool* pool) :
+	resolution(resolution), pool(pool)
+{
+	this->height[0].assign(resolution * resolution, 0.0f);
+	this->height[1].assign(resolution * resolution, 0.0f);
+	this->heightSlope.assign(resolution * resolution * 4, 0.0f);
+}
+
+void WaveSolver::addImpulse(const glm::vec2& uv, float strength, float radius)
+{
+	std::lock_guard<std::mutex> lock(this->impulseMutex);
+	this->pendingImpulses.push_back(glm::vec4(uv, strength, radius));
+}
+
+void WaveSolver::clear()
+{
+	std::fill(this->height[0].begin(), this->height[0].end(), 0.0f);
+	std::fill(this->height[1].begin(), this->height[1].end(), 0.0f);
+	std::fill(this->heightSlope.begin(), this->heightSlope.end(), 0.0f);
+	this->dirty = true;
+}
+
+void WaveSolver::step()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->impulseMutex);
+		this->stepImpulses.swap(this->pendingImpulses);
+	}
+	this->applyImpulses();
+	this->stepImpulses.clear();
+
+	//the boundary rows stay at rest (pool walls)
+	this->pool->parallelFor(1, this->resolution - 1, [this](int rowBegin, int rowEnd) { this->stepRows(rowBegin, rowEnd); });
+	this->current = 1 - this->current;
+	this->pool->parallelFor(0, this->resolution, [this](int rowBegin, int rowEnd) { this->slopeRows(rowBegin, rowEnd); });
+
+	this->dirty = true;
+}
+
+//Gaussian bump pushed into both time levels so it starts at rest
+void WaveSolver::applyImpulses()
+{
+	const int n = this->resolution;
+	float* curr = this->height[this->current].data();
+	float* prev = this->height[1 - this->current].data();
+	for (const glm::vec4& impulse : this->stepImpulses)
+	{
+		float cx = impulse.x * n - 0.5f;
+		float cy = impulse.y * n - 0.5f;
+		float r = std::max(impulse.w * n, 1.0f);
+		int reach = (int)std::ceil(r * 3.0f);
+		int x0 = std::max(1, (int)cx - reach), x1 = std::min(n - 2, (int)cx + reach);
+		int y0 = std::max(1, (int)cy - reach), y1 = std::min(n - 2, (int)cy + reach);
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int x = x0; x <= x1; x++)
+			{
+				float dx = x - cx, dy = y - cy;
+				float bump = -impulse.z * std::exp(-(dx * dx + dy * dy) / (r * r));
+				curr[y * n + x] += bump;
+				prev[y * n + x] += bump;
+			}
+		}
+	}
+}
+
+//next = (2 * curr - prev + courant * laplacian(curr)) * damping, written over prev
+void WaveSolver::stepRows(int rowBegin, int rowEnd)
+{
+	const int n = this->resolution;
+	const float* curr = this->height[this->current].data();
+	float* prev = this->height[1 - this->current].data();
+	const float k = this->courant;
+	const float d = this->damping;
+
+	for (int y = rowBegin; y < rowEnd; y++)
+	{
+		const float* c = curr + y * n;
+		const float* up = c - n;
+		const float* down = c + n;
+		float* p = prev + y * n;
+		int x = 1;
+#if defined(WAVE_SOLVER_AVX)
+		const __m256 vk = _mm256_set1_ps(k), vd = _mm256_set1_ps(d);
+		const __m256 two = _mm256_set1_ps(2.0f), four = _mm256_set1_ps(4.0f);
+		for (; x + 8 <= n - 1; x += 8)
+		{
+			__m256 center = _mm256_loadu_ps(c + x);
+			__m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(c + x - 1), _mm256_loadu_ps(c + x + 1)),
+				_mm256_add_ps(_mm256_loadu_ps(up + x), _mm256_loadu_ps(down + x)));
+			__m256 lap = _mm256_sub_ps(sum, _mm256_mul_ps(four, center));
+			__m256 next = _mm256_sub_ps(_mm256_mul_ps(two, center), _mm256_loadu_ps(p + x));
+			next = _mm256_mul_ps(_mm256_add_ps(next, _mm256_mul_ps(vk, lap)), vd);
+			_mm256_storeu_ps(p + x, next);
+		}
+#elif defined(WAVE_SOLVER_SSE)
+		const __m128 vk = _mm_set1_ps(k), vd = _mm_set1_ps(d);
+		const __m128 two = _mm_set1_ps(2.0f), four = _mm_set1_ps(4.0f);
+		for (; x + 4 <= n - 1; x += 4)
+		{
+			__m128 center = _mm_loadu_ps(c + x);
+			__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(c + x - 1), _mm_loadu_ps(c + x + 1)),
+				_mm_add_ps(_mm_loadu_ps(up + x), _mm_loadu_ps(down + x)));
+			__m128 lap = _mm_sub_ps(sum, _mm_mul_ps(four, center));
+			__m128 next = _mm_sub_ps(_mm_mul_ps(two, center), _mm_loadu_ps(p + x));
+			next = _mm_mul_ps(_mm_add_ps(next, _mm_mul_ps(vk, lap)), vd);
+			_mm_storeu_ps(p + x, next);
+		}
+#endif
+		for (; x < n - 1; x++)
+		{
+			float lap = c[x - 1] + c[x + 1] + up[x] + down[x] - 4.0f * c[x];
+			p[x] = (2.0f * c[x] - p[x] + k * lap) * d;
+		}
+	}
+}
+
+//slopes are in height units per texture coordinate unit, like the shader expects
+void WaveSolver::slopeRows(int rowBegin, int rowEnd)
+{
+	const int n = this->resolution;
+	const float* h = this->height[this->current].data();
+	const float scale = 0.5f * n;
+	for (int y = rowBegin; y < rowEnd; y++)
+	{
+		const float* row = h + y * n;
+		const float* up = h + std::max(y - 1, 0) * n;
+		const float* down = h + std::min(y + 1, n - 1) * n;
+		float* out = this->heightSlope.data() + y * n * 4;
+		for (int x = 0; x < n; x++)
+		{
+			float left = row[std::max(x - 1, 0)];
+			float right = row[std::min(x + 1, n - 1)];
+			out[x * 4 + 0] = (right - left) * scale;
+			out[x * 4 + 1] = (down[x] - up[x]) * scale;
+			out[x * 4 + 2] = row[x];
+			out[x * 4 + 3] = 0.0f;
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <mutex>
+#include <vector>
+
+#include "Utilities/ThreadPool.h"
+
+//Damped 2D wave equation on a grid covering the water surface texture space [0,1]x[0,1]
+//Two height buffers are swapped every step, the rows are split in bands over the thread pool
+//and every step ends with a packed RGBA float image (dh/du, dh/dv, h, 0) ready for upload
+class WaveSolver
+{
+public:
+	WaveSolver(int resolution = 256, ThreadPool* pool = &ThreadPool::shared());
+
+	//Can be called from any thread, impulses are applied at the start of the next step
+	void addImpulse(const glm::vec2& uv, float strength = 1.0f, float radius = 0.01f);
+	void step();
+	void clear();
+
+	int getResolution() const { return this->resolution; }
+	const float* getHeightSlope() const { return this->heightSlope.data(); }
+
+	//c^2 * dt^2 / dx^2, has to stay below 0.5 to be stable
+	float courant = 0.25f;
+	float damping = 0.996f;
+	//set by step, cleared by whoever uploads the result
+	bool dirty = false;
+
+private:
+	void applyImpulses();
+	void stepRows(int rowBegin, int rowEnd);
+	void slopeRows(int rowBegin, int rowEnd);
+
+	int resolution;
+	int current = 0;
+	std::vector<float> height[2];
+	std::vector<float> heightSlope;
+
+	std::mutex impulseMutex;
+	std::vector<glm::vec4> pendingImpulses;
+	std::vector<glm::vec4> stepImpulses;
+
+	ThreadPool* pool;
+};
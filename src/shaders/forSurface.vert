@@ -8,44 +8,7 @@ layout (location = 3) in vec3 color;
 uniform mat4 u_model;
 uniform vec3 u_viewer_pos;
 uniform int u_shadingSelect;
-struct DirLight {
-    vec3 direction;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};  
-struct PointLight {    
-    vec3 position;   
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-	float constant;
-    float linear;
-    float quadratic;  
-};  
-struct SpotLight {    
-    vec3 position;
-        
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-	float constant;
-    float linear;
-    float quadratic;  
-
-	 vec3 direction;
-	 float cutoff;
-	 float outer_cutoff;
-};    
-#define NR_DIRECTIONAL_LIGHTS 4  
-uniform DirLight dirLights[NR_DIRECTIONAL_LIGHTS];
-#define NR_POINT_LIGHTS 4  
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-#define NR_SPOT_LIGHTS 4
-uniform  SpotLight spotLights[NR_SPOT_LIGHTS];
+#include "shading.glsl"
 
 uniform sampler2D u_texture;
 uniform bool u_useTexture;
@@ -55,6 +18,9 @@ layout (std140, binding = 0) uniform commom_matrices
     mat4 u_projection;
     mat4 u_view;
 };
+#include "lights.glsl"
+//the flashlight only lights the objects
+#define NO_SPOT_LIGHTS
 
 
 out vec3 c_in_position;
@@ -136,7 +102,7 @@ void main()
     c_in_position = vec3(u_model * vec4(position, 1.0f));
     c_in_normal = mat3(transpose(inverse(u_model))) * normal;
     c_in_texture_coordinate = vec2(texture_coordinate.x, 1.0f - texture_coordinate.y);
-	if(u_shadingSelect==0||u_shadingSelect==1||u_shadingSelect==3)
+	if(shadingSelect==0||shadingSelect==1||shadingSelect==3)
 	{
 		c_in_color = color;
 	}
@@ -156,18 +122,21 @@ void main()
 		vec3 result = vec3(0,0,0);
 		vec3 _normal = normalize( c_in_normal);
 		vec3 viewDir = normalize(u_viewer_pos - c_in_position);
-		for(int i=0;i<NR_DIRECTIONAL_LIGHTS;i++)
+		for(int i=0;i<u_lightCounts.x;i++)
 		{
 			result += CalcDirLight(dirLights[i], _normal, viewDir, sourceColor);
 		}
-		for(int i=0;i<NR_POINT_LIGHTS;i++)
+		ivec4 cluster = vertexLightCluster(c_in_position);
+		for(int i=0;i<cluster.y;i++)
 		{
-			result += CalcPointLight(pointLights[i], _normal, c_in_position, viewDir, sourceColor);
+			result += CalcPointLight(pointLights[clusterLight(cluster.x, i)], _normal, c_in_position, viewDir, sourceColor);
 		}
-		for(int i=0;i<NR_SPOT_LIGHTS;i++)
+#ifndef NO_SPOT_LIGHTS
+		for(int i=0;i<cluster.w;i++)
 		{
-			result += CalcSpotLight(spotLights[i], _normal, c_in_position, viewDir, sourceColor);
+			result += CalcSpotLight(spotLights[clusterLight(cluster.z, i)], _normal, c_in_position, viewDir, sourceColor);
 		}
+#endif
 		c_in_color = result;
 	}
 }
\ No newline at end of file
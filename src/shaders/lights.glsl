@@ -0,0 +1,84 @@
+//LightSet, the directional lights in a std140 block, point and spot lights in storage buffers
+//of any length. The members are ordered so each float fills the fourth component after a vec3
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+struct SpotLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+    float cutoff;
+    vec3 direction;
+    float outer_cutoff;
+};
+#define NR_DIRECTIONAL_LIGHTS 4
+layout (std140, binding = 2) uniform light_set
+{
+    ivec4 u_lightCounts;    //directional, point, spot
+    DirLight dirLights[NR_DIRECTIONAL_LIGHTS];
+};
+layout (std430, binding = 4) readonly buffer point_lights
+{
+    PointLight pointLights[];
+};
+layout (std430, binding = 5) readonly buffer spot_lights
+{
+    SpotLight spotLights[];
+};
+
+//LightClusters of the pass, tiles uniform in screen space and slices exponential in depth
+layout (std430, binding = 6) readonly buffer light_clusters
+{
+    ivec4 u_clusterGrid;        //tiles x, tiles y, slices
+    vec4 u_clusterDepth;        //near, slices / log(far / near), far
+    ivec4 u_lightClusters[];    //point offset, point count, spot offset, spot count into u_lightIndices
+};
+layout (std430, binding = 7) readonly buffer light_indices
+{
+    int u_lightIndices[];
+};
+
+//the point and spot lights that can reach a world position, through commom_matrices of the pass
+ivec4 lightCluster(vec3 position)
+{
+    vec4 view = u_view * vec4(position, 1.0);
+    vec4 clip = u_projection * view;
+    vec2 ndc = clip.xy / max(clip.w, 0.000001);
+    vec2 tile = clamp(floor((ndc * 0.5 + 0.5) * vec2(u_clusterGrid.xy)), vec2(0.0), vec2(u_clusterGrid.xy - 1));
+    float slice = clamp(floor(log(max(-view.z, u_clusterDepth.x) / u_clusterDepth.x) * u_clusterDepth.y), 0.0, float(u_clusterGrid.z - 1));
+    return u_lightClusters[(int(slice) * u_clusterGrid.y + int(tile.y)) * u_clusterGrid.x + int(tile.x)];
+}
+
+//lightCluster for lighting per vertex. A vertex off screen, behind the eye or past the last
+//slice still shades the visible part of its triangle, but the lights culled there are missing
+//from the cluster it is clamped into, so it gets all of them: offset -1 counts the lights directly
+ivec4 vertexLightCluster(vec3 position)
+{
+    vec4 view = u_view * vec4(position, 1.0);
+    vec4 clip = u_projection * view;
+    if(clip.w <= 0.0 || any(greaterThan(abs(clip.xy), vec2(clip.w))) || -view.z > u_clusterDepth.z)
+        return ivec4(-1, u_lightCounts.y, -1, u_lightCounts.z);
+    return lightCluster(position);
+}
+
+//i-th light of a cluster's point (offset x) or spot (offset z) range
+int clusterLight(int offset, int i)
+{
+    return offset < 0 ? i : u_lightIndices[offset + i];
+}
@@ -7,6 +7,28 @@ uniform sampler2D u_frame;
 uniform int u_effect;
 uniform float u_time;
 
+//a variant only has the effects given as EFFECT_ defines, the generic program tests u_effect
+#ifdef VARIANT
+#ifdef EFFECT_PIXELATE
+#define EFFECT_BIT_PIXELATE 0x01
+#else
+#define EFFECT_BIT_PIXELATE 0
+#endif
+#ifdef EFFECT_OFFSET
+#define EFFECT_BIT_OFFSET 0x02
+#else
+#define EFFECT_BIT_OFFSET 0
+#endif
+#ifdef EFFECT_ROTATE
+#define EFFECT_BIT_ROTATE 0x04
+#else
+#define EFFECT_BIT_ROTATE 0
+#endif
+#define effect (EFFECT_BIT_PIXELATE | EFFECT_BIT_OFFSET | EFFECT_BIT_ROTATE)
+#else
+#define effect u_effect
+#endif
+
 void main()
 {   
 	vec2 texture_coordinate = o_texture_coordinate;
@@ -14,7 +36,7 @@ void main()
 	f_color = vec4(texture(u_frame, texture_coordinate));
 	
 
-	if((u_effect&0x01)!=0)
+	if((effect&0x01)!=0)
 	{
 		if(o_texture_coordinate.x>0.5)
 		{
@@ -28,7 +50,7 @@ void main()
 		}
 		
 	}
-	if((u_effect&0x02)!=0)
+	if((effect&0x02)!=0)
 	{
 		if(o_texture_coordinate.x>0.5)
 		{
@@ -40,7 +62,7 @@ void main()
 		}
 		
 	}
-	if((u_effect&0x04)!=0)
+	if((effect&0x04)!=0)
 	{
 		if(o_texture_coordinate.x>0.5)
 		{
@@ -56,7 +78,7 @@ void main()
 		
 	}
 	
-	if(u_effect!=0 && o_texture_coordinate.x>=0.495&&o_texture_coordinate.x<=0.505)
+	if(effect!=0 && o_texture_coordinate.x>=0.495&&o_texture_coordinate.x<=0.505)
 	{
 			f_color = vec4(1.0,0,0,1.0);
 	}
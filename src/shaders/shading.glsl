@@ -0,0 +1,14 @@
+//a variant compiled with one SHADING_ define keeps only that model (0 none, 1 Phong,
+//2 Gouraud, 3 toon), the generic program switches on u_shadingSelect
+#if defined(SHADING_NONE)
+#define shadingSelect 0
+#elif defined(SHADING_PHONG)
+#define shadingSelect 1
+#elif defined(SHADING_GOURAUD)
+#define shadingSelect 2
+#elif defined(SHADING_TOON)
+#define shadingSelect 3
+#else
+#define shadingSelect u_shadingSelect
+#endif
+
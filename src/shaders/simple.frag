@@ -8,44 +8,13 @@ in vec3 o_color;
 
 uniform vec3 u_viewer_pos;
 uniform int u_shadingSelect;
-struct DirLight {
-    vec3 direction;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};  
-struct PointLight {    
-    vec3 position;   
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-	float constant;
-    float linear;
-    float quadratic;  
-};  
-struct SpotLight {    
-    vec3 position;
-        
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-	float constant;
-    float linear;
-    float quadratic;  
-
-	 vec3 direction;
-	 float cutoff;
-	 float outer_cutoff;
-};  
-#define NR_DIRECTIONAL_LIGHTS 4  
-uniform DirLight dirLights[NR_DIRECTIONAL_LIGHTS];
-#define NR_POINT_LIGHTS 4  
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-#define NR_SPOT_LIGHTS 4
-uniform  SpotLight spotLights[NR_SPOT_LIGHTS];
+layout (std140, binding = 0) uniform commom_matrices
+{
+    mat4 u_projection;
+    mat4 u_view;
+};
+#include "lights.glsl"
+#include "shading.glsl"
 
 uniform bool u_useTexture;
 uniform sampler2D u_texture;
@@ -61,7 +30,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 materialColor)
     vec3 halfwayDir  = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), 64);
 
-	if(u_shadingSelect==3)
+	if(shadingSelect==3)
 	{
 		diff=floor(diff*toonStage)/toonStage;
 		spec=floor(spec*toonStage)/toonStage;
@@ -83,7 +52,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, v
     vec3 halfwayDir  = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), 64);
 
-	if(u_shadingSelect==3)
+	if(shadingSelect==3)
 	{
 		diff=floor(diff*toonStage)/toonStage;
 		spec=floor(spec*toonStage)/toonStage;
@@ -113,7 +82,7 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec
     vec3 halfwayDir  = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), 64);
 
-	if(u_shadingSelect==3)
+	if(shadingSelect==3)
 	{
 		diff=floor(diff*toonStage)/toonStage;
 		spec=floor(spec*toonStage)/toonStage;
@@ -152,27 +121,30 @@ void main()
 	}
 	
 
-	if(u_shadingSelect == 0)
+	if(shadingSelect == 0)
 	{
 		f_color = vec4(sourceColor, 1.0f);
 	}
-	else if(u_shadingSelect == 1||u_shadingSelect==3)
+	else if(shadingSelect == 1||shadingSelect==3)
 	{
 		vec3 result = vec3(0,0,0);
 		vec3 _normal = normalize( o_normal);
 		vec3 viewDir = normalize(u_viewer_pos - o_position);
-		for(int i=0;i<NR_DIRECTIONAL_LIGHTS;i++)
+		for(int i=0;i<u_lightCounts.x;i++)
 		{
 			result += CalcDirLight(dirLights[i], _normal, viewDir, sourceColor);
 		}
-		for(int i=0;i<NR_POINT_LIGHTS;i++)
+		ivec4 cluster = lightCluster(o_position);
+		for(int i=0;i<cluster.y;i++)
 		{
-			result += CalcPointLight(pointLights[i], _normal, o_position, viewDir, sourceColor);
+			result += CalcPointLight(pointLights[u_lightIndices[cluster.x + i]], _normal, o_position, viewDir, sourceColor);
 		}
-		for(int i=0;i<NR_SPOT_LIGHTS;i++)
+#ifndef NO_SPOT_LIGHTS
+		for(int i=0;i<cluster.w;i++)
 		{
-			result += CalcSpotLight(spotLights[i], _normal, o_position, viewDir, sourceColor);
+			result += CalcSpotLight(spotLights[u_lightIndices[cluster.z + i]], _normal, o_position, viewDir, sourceColor);
 		}
+#endif
 		f_color = vec4(result, 1);
 	}
 	else 
@@ -0,0 +1,303 @@
+//Wave models shared by the tessellation shader and the bake pass
+//every model turns a texture coordinate and the flat surface position into
+//a displaced position and a normal
+
+uniform vec2 u_direction;
+uniform float u_time;
+uniform float u_wavelength;
+uniform float u_amplitude;
+uniform int u_waveSelect;
+uniform highp sampler3D u_heightmap;	//one slice per frame, filtered between frames
+uniform float u_heightmapFrames;
+uniform float u_heightmapRate;			//frames per time unit
+uniform highp sampler2DArray u_heightmapLayers;	//the same frames block compressed, one layer each
+uniform bool u_heightmapArray;
+uniform highp sampler3D u_heightmapSlope;	//baked slope per tile of the same frames, rg like the ocean tile
+uniform bool u_useHeightmapSlope;
+uniform int u_simSelect;
+uniform sampler2D u_simMap;
+uniform bool u_useOcean;
+uniform sampler2D u_oceanMap;
+
+//drops binned by DropBins, a cell lists the ring slots whose ripple can reach it
+layout (std430, binding = 1) readonly buffer drop_data
+{
+	vec4 u_drops[];			//xy position, z start time, w amplitude
+};
+layout (std430, binding = 2) readonly buffer drop_cells
+{
+	ivec2 u_dropCells[];	//offset, count into u_dropIndices
+};
+layout (std430, binding = 3) readonly buffer drop_indices
+{
+	int u_dropIndices[];
+};
+uniform int u_dropGridSize;
+
+//RippleLut, x = dist - t_c in [-range.x, range.x], y = t_c in [0, range.y]
+//r = profile, g = derivative along dist
+uniform bool u_useRippleLut;
+uniform sampler2D u_rippleLut;
+uniform vec2 u_rippleLutRange;
+
+#define MAX_GERSTNER_WAVES 64
+
+struct GerstnerWave
+{
+	vec4 directionFrequency;		//xy direction, z wave number, w angular speed
+	vec4 amplitudeSteepnessPhase;	//x amplitude, y steepness, z phase
+};
+layout (std140, binding = 1) uniform gerstner_waves
+{
+	ivec4 u_gerstnerCount;
+	GerstnerWave u_gerstner[MAX_GERSTNER_WAVES];
+};
+
+//a variant compiled with one WAVE_ define keeps only that model, the generic program
+//and anything a variant leaves open switch on the uniforms
+#if defined(WAVE_SINE)
+#define waveSelect 0
+#elif defined(WAVE_HEIGHTMAP)
+#define waveSelect 1
+#define useOcean false
+#elif defined(WAVE_OCEAN)
+#define waveSelect 1
+#define useOcean true
+#elif defined(WAVE_RIPPLES)
+#define waveSelect 2
+#define simSelect 0
+#define useRippleLut false
+#elif defined(WAVE_RIPPLE_LUT)
+#define waveSelect 2
+#define simSelect 0
+#define useRippleLut true
+#elif defined(WAVE_SOLVER)
+#define waveSelect 2
+#define simSelect 1
+#elif defined(WAVE_GERSTNER)
+#define waveSelect 3
+#endif
+#ifndef waveSelect
+#define waveSelect u_waveSelect
+#endif
+#ifndef simSelect
+#define simSelect u_simSelect
+#endif
+#ifndef useOcean
+#define useOcean u_useOcean
+#endif
+#ifndef useRippleLut
+#define useRippleLut u_useRippleLut
+#endif
+
+//FFT ocean tile, rg = slope per tile, b = height in [-1,1], repeats every u_wavelength*8
+vec3 getOceanCoord(in vec2 heightmapCoord, in vec3 XandZ)
+{
+		XandZ.y = u_amplitude * texture(u_oceanMap, heightmapCoord / (u_wavelength*8)).b;
+		return XandZ;
+}
+
+vec3 getOceanNormal(in vec2 heightmapCoord)
+{
+		vec2 slope = u_amplitude * texture(u_oceanMap, heightmapCoord / (u_wavelength*8)).rg / (u_wavelength*8);
+		return normalize(vec3(-slope.x, 200.0, slope.y));
+}
+
+vec3 getHeightMapCoord(in vec2 heightmapCoord, in vec3 XandZ)
+{
+		if(useOcean)
+			return getOceanCoord(heightmapCoord, XandZ);
+		heightmapCoord+=u_direction*(u_time/20);
+		heightmapCoord/=(u_wavelength*8);		
+		heightmapCoord = heightmapCoord - (vec2(1,1) * floor(heightmapCoord.xy));
+		float height;
+		if(u_heightmapArray)
+		{
+			//layers are not filtered against each other, blend the two around the frame like the 3D stack does
+			float frame = u_time*u_heightmapRate;
+			float first = floor(frame);
+			float a = texture(u_heightmapLayers, vec3(heightmapCoord, mod(first, u_heightmapFrames))).r;
+			float b = texture(u_heightmapLayers, vec3(heightmapCoord, mod(first + 1.0, u_heightmapFrames))).r;
+			height = mix(a, b, frame - first);
+		}
+		else
+		{
+			float frame = (u_time*u_heightmapRate + 0.5)/u_heightmapFrames;
+			height = texture(u_heightmap, vec3(heightmapCoord, frame)).r;
+		}
+		XandZ.y= 2*u_amplitude *(height - 0.5);
+		return XandZ;
+}
+
+vec3 getSineCoord(in vec2 heightmapCoord, in vec3 XandZ)
+{
+		XandZ.y = u_amplitude * sin((2*3.14)*(dot(u_direction ,heightmapCoord)+u_time)/u_wavelength);
+		return XandZ;
+}
+//sum of Gerstner waves at a world position, the normal comes from the analytic
+//tangent frame of the same sum so every wave is evaluated once
+vec3 getGerstnerCoord(in vec3 XandZ, out vec3 normal)
+{
+	vec3 position = vec3(XandZ.x, 0.0, XandZ.z);
+	normal = vec3(0.0, 1.0, 0.0);
+	for(int i=0;i<u_gerstnerCount.x;i++)
+	{
+		vec2 direction = u_gerstner[i].directionFrequency.xy;
+		float k = u_gerstner[i].directionFrequency.z;
+		float amplitude = u_gerstner[i].amplitudeSteepnessPhase.x;
+		float steepness = u_gerstner[i].amplitudeSteepnessPhase.y;
+		float theta = k*dot(direction, XandZ.xz) - u_gerstner[i].directionFrequency.w*u_time + u_gerstner[i].amplitudeSteepnessPhase.z;
+		float s = sin(theta);
+		float c = cos(theta);
+		position.xz += steepness*amplitude*direction*c;
+		position.y += amplitude*s;
+		float ka = k*amplitude;
+		normal.xz -= direction*ka*c;
+		normal.y -= steepness*ka*s;
+	}
+	normal = normalize(normal);
+	return position;
+}
+
+float delta = 0.0001;
+vec3 getHeightMapNormal(in vec2 heightmapCoord, in vec3 XandZ)
+{	
+	if(useOcean)
+		return getOceanNormal(heightmapCoord);
+	if(u_useHeightmapSlope)
+	{
+		//same tile and frame as getHeightMapCoord, the height there is u_amplitude * b like the ocean's
+		vec2 tile = (heightmapCoord + u_direction*(u_time/20)) / (u_wavelength*8);
+		float frame = (u_time*u_heightmapRate + 0.5)/u_heightmapFrames;
+		vec2 slope = u_amplitude * texture(u_heightmapSlope, vec3(tile, frame)).rg / (u_wavelength*8);
+		return normalize(vec3(-slope.x, 200.0, slope.y));
+	}
+	
+	vec3 dx = vec3(
+        delta*400,
+        getHeightMapCoord(vec2(heightmapCoord.x+delta,heightmapCoord.y), XandZ).y - getHeightMapCoord(vec2(heightmapCoord.x-delta,heightmapCoord.y), XandZ).y,
+        0.0);
+	vec3 dy = vec3(
+        0.0,
+        getHeightMapCoord(vec2(heightmapCoord.x,heightmapCoord.y+delta), XandZ).y - getHeightMapCoord(vec2(heightmapCoord.x,heightmapCoord.y-delta), XandZ).y,
+        -delta*400);
+
+	return normalize( cross(-dy,dx));
+}
+
+vec3 getSineNormal(in vec2 heightmapCoord, in vec3 XandZ)
+{
+	
+	vec3 dx = vec3(
+        delta*400,
+        getSineCoord(vec2(heightmapCoord.x+delta,heightmapCoord.y), XandZ).y -  getSineCoord(vec2(heightmapCoord.x-delta,heightmapCoord.y), XandZ).y,
+        0.0);
+	vec3 dy = vec3(
+        0.0,
+        getSineCoord(vec2(heightmapCoord.x,heightmapCoord.y+delta), XandZ).y - getSineCoord(vec2(heightmapCoord.x,heightmapCoord.y-delta), XandZ).y,
+        -delta*400);
+
+	return normalize( cross(-dy,dx));
+}
+
+vec3 getSimCoord(in vec2 heightmapCoord, in vec3 XandZ)
+{
+	XandZ.y = 0;
+	ivec2 cell = clamp(ivec2(heightmapCoord*u_dropGridSize), ivec2(0), ivec2(u_dropGridSize-1));
+	ivec2 range = u_dropCells[cell.y*u_dropGridSize + cell.x];
+	for(int i=range.x;i<range.x+range.y;i++)
+	{
+		vec4 drop = u_drops[u_dropIndices[i]];
+		float dist = distance(heightmapCoord, drop.xy)/(u_wavelength)*30;
+		float t_c = (u_time-drop.z)*(2*3.1415926)*5.0;
+		XandZ.y += u_amplitude * drop.w * sin((dist-t_c)*clamp(0.0125*t_c,0,1))/(exp(0.1*abs(dist-t_c)+(0.05*t_c)))*1.5;
+	}
+	return XandZ;
+}
+
+vec3 getSimNormal(in vec2 heightmapCoord, in vec3 XandZ)
+{	
+	vec3 dx = vec3(
+        delta*200,
+        getSimCoord(vec2(heightmapCoord.x+delta,heightmapCoord.y), XandZ).y -  XandZ.y,
+        0.0);
+	vec3 dy = vec3(
+        0.0,
+        getSimCoord(vec2(heightmapCoord.x,heightmapCoord.y+delta), XandZ).y - XandZ.y,
+        -delta*200);
+
+	return normalize( cross(-dy,dx));
+}
+
+//same ripples as getSimCoord from the table, the normal uses the radial derivative
+//so the drops are only visited once
+vec3 getSimLutCoord(in vec2 heightmapCoord, in vec3 XandZ, out vec3 normal)
+{
+	XandZ.y = 0;
+	vec2 slope = vec2(0.0);
+	ivec2 cell = clamp(ivec2(heightmapCoord*u_dropGridSize), ivec2(0), ivec2(u_dropGridSize-1));
+	ivec2 range = u_dropCells[cell.y*u_dropGridSize + cell.x];
+	for(int i=range.x;i<range.x+range.y;i++)
+	{
+		vec4 drop = u_drops[u_dropIndices[i]];
+		vec2 offset = heightmapCoord - drop.xy;
+		float dist = length(offset)/(u_wavelength)*30;
+		float t_c = (u_time-drop.z)*(2*3.1415926)*5.0;
+		vec2 lut = vec2((dist-t_c)/u_rippleLutRange.x*0.5 + 0.5, t_c/u_rippleLutRange.y);
+		if(t_c <= 0 || any(lessThan(lut, vec2(0.0))) || any(greaterThan(lut, vec2(1.0))))
+			continue;
+		vec2 profile = u_amplitude * drop.w * texture(u_rippleLut, lut).rg;
+		XandZ.y += profile.r;
+		if(dist > 0.0)
+			slope += profile.g * 30/u_wavelength * offset/length(offset);
+	}
+	normal = normalize(vec3(-slope.x, 200.0, slope.y));
+	return XandZ;
+}
+
+//heightfield from the ripple solver, rg = slope per texture unit, b = height
+vec3 getSolverCoord(in vec2 heightmapCoord, in vec3 XandZ)
+{
+	XandZ.y = u_amplitude * texture(u_simMap, heightmapCoord).b;
+	return XandZ;
+}
+
+vec3 getSolverNormal(in vec2 heightmapCoord)
+{
+	vec2 slope = u_amplitude * texture(u_simMap, heightmapCoord).rg;
+	return normalize(vec3(-slope.x, 200.0, slope.y));
+}
+
+//the model picked by u_waveSelect or the variant (0 sine, 1 height map, 2 interactive, 3 gerstner)
+vec3 evaluateWave(in vec2 uv, in vec3 position, out vec3 normal)
+{
+	if(waveSelect==2 && simSelect==1)
+	{
+		position = getSolverCoord(uv, position);
+		normal = getSolverNormal(uv);
+	}
+	else if(waveSelect==2 && useRippleLut)
+	{
+		position = getSimLutCoord(uv, position, normal);
+	}
+	else if(waveSelect==2)
+	{
+		position = getSimCoord(uv, position);
+		normal = getSimNormal(uv, position);
+	}
+	else if(waveSelect==3)
+	{
+		position = getGerstnerCoord(position, normal);
+	}
+	else if(waveSelect==1)
+	{
+		position = getHeightMapCoord(uv, position);
+		normal = getHeightMapNormal(uv, position);
+	}
+	else
+	{
+		position = getSineCoord(uv, position);
+		normal = getSineNormal(uv, position);
+	}
+	return position;
+}